@@ -0,0 +1,125 @@
+"""
+Synthetic HULK programs for the front-end benchmarks, in a few shapes
+that stress different parts of the lexer and parser:
+
+    block    one long top-level statement block (lets, calls, prints)
+    nested   while loops nested --depth deep, like deep_nested_while.hk
+    classes  a tree of types, --width children under each, with
+             fields and methods
+    arith    print()s of arithmetic chains --length operators long
+
+The unit of each shape is repeated until the program is --size bytes.
+The output only has to parse; it is not meant to type check.
+
+    python bench/corpus.py block --size 4M > block.hk
+"""
+
+import argparse
+import random
+import sys
+
+
+def block(index: int, args) -> str:
+    name = f"v{index}"
+    return (
+        f"let {name} = {index} * 2 + 1;\n"
+        f"print({name} - {index % 7});\n"
+        f'prints("line {index}");\n'
+    )
+
+
+def nested(index: int, args) -> str:
+    lines = []
+    for level in range(args.depth):
+        indent = "    " * level
+        lines.append(f"{indent}let c{level} = {level + 2};")
+        lines.append(f"{indent}while (c{level}) {{")
+        lines.append(f"{indent}    let c{level} = c{level} - 1;")
+    lines.append("    " * args.depth + f"print(c0 + {index});")
+    for level in reversed(range(args.depth)):
+        lines.append("    " * level + "};")
+    return "\n".join(lines) + "\n"
+
+
+def classes(index: int, args) -> str:
+    if index == 0:
+        header = "type T0"
+    else:
+        header = f"type T{index} inherits T{(index - 1) // args.width}"
+    return (
+        f"{header} {{\n"
+        f"    x{index} = {index};\n"
+        f"    y{index} = {index} + 1;\n"
+        f"\n"
+        f"    get{index}(a) => self.x{index} + a;\n"
+        f"    sum{index}(a, b) => a * b + self.y{index};\n"
+        f"}};\n"
+    )
+
+
+def arith(index: int, args) -> str:
+    rng = random.Random(index)
+    terms = [str(rng.randint(1, 999))]
+    for _ in range(args.length):
+        operator = rng.choice("+-*/")
+        operand = str(rng.randint(1, 999))
+        if rng.random() < 0.2:
+            operand = f"({operand} + {rng.randint(1, 9)})"
+        terms.append(f"{operator} {operand}")
+    return f"print({' '.join(terms)});\n"
+
+
+SHAPES = {"block": block, "nested": nested, "classes": classes, "arith": arith}
+
+
+def parse_size(text: str) -> int:
+    units = {"K": 1 << 10, "M": 1 << 20, "G": 1 << 30}
+    if text[-1:].upper() in units:
+        return int(float(text[:-1]) * units[text[-1].upper()])
+    return int(text)
+
+
+def generate(shape: str, size: int, args) -> str:
+    unit = SHAPES[shape]
+    parts = []
+    total = 0
+    index = 0
+    while total < size:
+        part = unit(index, args)
+        parts.append(part)
+        total += len(part)
+        index += 1
+    return "".join(parts)
+
+
+def run_tests():
+    args = argparse.Namespace(depth=3, width=4, length=5)
+    for shape in SHAPES:
+        text = generate(shape, 1000, args)
+        assert len(text) >= 1000, shape
+        assert text.count("{") == text.count("}"), shape
+        assert text.count("(") == text.count(")"), shape
+        assert text.endswith(";\n"), shape
+    # the same program every time, so runs can be compared
+    assert generate("arith", 1000, args) == generate("arith", 1000, args)
+    text = generate("classes", 2000, args)
+    assert "type T5 inherits T1" in text
+    print("All tests passed!")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("shape", choices=sorted(SHAPES) + ["test"])
+    parser.add_argument("--size", default="1M", help="bytes, with an optional K, M or G suffix")
+    parser.add_argument("--depth", type=int, default=8, help="while nesting (nested)")
+    parser.add_argument("--width", type=int, default=16, help="subtypes per type (classes)")
+    parser.add_argument("--length", type=int, default=64, help="operators per expression (arith)")
+    args = parser.parse_args()
+    if args.shape == "test":
+        run_tests()
+        return
+    sys.stdout.write(generate(args.shape, parse_size(args.size), args))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,183 @@
+// Front-end throughput on one file, in three stages: lexing alone, a
+// serial parse() and frontend_parse() with as many threads as the
+// compiler would use. Each stage runs over and over in a child process
+// of its own, so the peak RSS is the stage's (plus the source), and
+// prints one JSON object on a line:
+//
+//   {"tag": ..., "time": ..., "file": ..., "stage": "parse", "bytes": ..., "tokens": ...,
+//    "runs": ..., "seconds": ..., "mb_per_s": ..., "tokens_per_s": ...,
+//    "peak_rss_kb": ..., "scan": "avx2", "cores": ...}
+//
+//   bench/frontend <file> [seconds] [tag]
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "compiler.h"
+#include "frontend.h"
+#include "intern.h"
+#include "lexer.h"
+#include "parser.h"
+#include "scan.h"
+
+typedef enum {
+    STAGE_LEX,
+    STAGE_PARSE,
+    STAGE_FRONTEND,
+} Stage;
+
+static const char* stage_names[] = {"lex", "parse", "frontend"};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long count_tokens(const char* source, size_t length) {
+    LexerState lexer;
+    lexer_init(&lexer, source, length);
+    unsigned long tokens = 0;
+    while (lexer_next_token(&lexer).type != TOKEN_EOF) {
+        tokens += 1;
+    }
+    return tokens;
+}
+
+// one pass of stage over the source; false on parse errors
+static bool run_once(Stage stage, const char* path, const char* source, size_t length) {
+    int errors = 0;
+    switch (stage) {
+        case STAGE_LEX:
+            count_tokens(source, length);
+            break;
+        case STAGE_PARSE: {
+            Arena arena;
+            InternTable names;
+            LineIndex lines;
+            arena_init(&arena);
+            arena_set_current(&arena);
+            intern_table_init(&names);
+            intern_set_current(&names);
+            line_index_init(&lines, source, length);
+            line_index_set_current(&lines);
+            LexerState lexer;
+            lexer_init(&lexer, source, length);
+            parse(&lexer, &errors);
+            line_index_set_current(NULL);
+            line_index_release(&lines);
+            intern_set_current(NULL);
+            intern_table_release(&names);
+            arena_set_current(NULL);
+            arena_release(&arena);
+            break;
+        }
+        case STAGE_FRONTEND: {
+            Compilation compilation;
+            compilation_init(&compilation, path, NULL, NULL);
+            arena_set_current(&compilation.arena);
+            intern_set_current(&compilation.names);
+            line_index_init(&compilation.lines, source, length);
+            line_index_set_current(&compilation.lines);
+            frontend_parse(&compilation, source, length, &errors);
+            line_index_set_current(NULL);
+            line_index_release(&compilation.lines);
+            intern_set_current(NULL);
+            intern_table_release(&compilation.names);
+            arena_set_current(NULL);
+            arena_release(&compilation.arena);
+            break;
+        }
+    }
+    return errors == 0;
+}
+
+static void print_string(const char* s) {
+    putchar('"');
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\') {
+            putchar('\\');
+        }
+        putchar(*s);
+    }
+    putchar('"');
+}
+
+static int run_stage(Stage stage, const char* path, const char* source, size_t length, unsigned long tokens, double budget, const char* tag) {
+    unsigned long runs = 0;
+    double start = now();
+    double elapsed;
+    do {
+        if (!run_once(stage, path, source, length)) {
+            fprintf(stderr, "%s: %s does not parse\n", stage_names[stage], path);
+            return 1;
+        }
+        runs += 1;
+        elapsed = now() - start;
+    } while (elapsed < budget);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("{\"tag\": ");
+    print_string(tag);
+    printf(", \"time\": %ld, \"file\": ", (long) time(NULL));
+    print_string(path);
+    printf(", \"stage\": \"%s\", \"bytes\": %zu, \"tokens\": %lu, \"runs\": %lu, \"seconds\": %.6f", stage_names[stage], length, tokens, runs, elapsed / runs);
+    printf(", \"mb_per_s\": %.1f, \"tokens_per_s\": %.0f", (double) length * runs / elapsed / 1e6, (double) tokens * runs / elapsed);
+    printf(", \"peak_rss_kb\": %ld, \"scan\": \"%s\", \"cores\": %ld}\n", usage.ru_maxrss, scan_kernel(), sysconf(_SC_NPROCESSORS_ONLN));
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <file> [seconds] [tag]\n", argv[0]);
+        return 1;
+    }
+    const char* path = argv[1];
+    double budget = (argc > 2) ? atof(argv[2]) : 1.0;
+    const char* tag = (argc > 3) ? argv[3] : "";
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* source = malloc(length + 1);
+    if (fread(source, 1, length, file) != (size_t) length) {
+        perror(path);
+        return 1;
+    }
+    source[length] = '\0';
+    fclose(file);
+
+    unsigned long tokens = count_tokens(source, length);
+    int failed = 0;
+    for (Stage stage = STAGE_LEX; stage <= STAGE_FRONTEND; stage++) {
+        fflush(stdout);
+        pid_t child = fork();
+        if (child == 0) {
+            int status = run_stage(stage, path, source, length, tokens, budget, tag);
+            fflush(stdout);
+            _exit(status);
+        }
+        int status;
+        if (child < 0 || waitpid(child, &status, 0) < 0) {
+            perror("fork");
+            return 1;
+        }
+        if (WIFSIGNALED(status)) {
+            // out of memory (SIGKILL) or stack (SIGSEGV) on big enough inputs
+            fprintf(stderr, "%s: %s killed by signal %d\n", stage_names[stage], path, WTERMSIG(status));
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failed = 1;
+        }
+    }
+    free(source);
+    return failed;
+}
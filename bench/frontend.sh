@@ -0,0 +1,24 @@
+#!/bin/sh
+# Front-end throughput on generated corpora (bench/corpus.py): MB/s,
+# tokens/s and peak RSS of lexing, parsing and the whole front end for
+# every shape. The JSON lines of bench/frontend are appended to the
+# results file, tagged with the commit, so runs can be compared over time.
+#
+#   sh bench/frontend.sh [results] [size] [seconds]
+set -e
+RESULTS=${1:-bench/results.jsonl}
+SIZE=${2:-4M}
+SECONDS_PER_RUN=${3:-1}
+BENCH=$(pwd)/bench/frontend
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+TAG=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+if ! git diff --quiet HEAD 2>/dev/null; then
+    TAG="$TAG-dirty"
+fi
+
+for shape in block nested classes arith; do
+    python bench/corpus.py $shape --size "$SIZE" > "$OUT/$shape.hk"
+    (cd "$OUT" && "$BENCH" $shape.hk "$SECONDS_PER_RUN" "$TAG") | tee -a "$RESULTS"
+done
@@ -0,0 +1,62 @@
+// Lexer throughput: lex a file over and over, print MB/s and a checksum
+// of the token stream (so two lexer backends can be checked against
+// each other).
+//
+//   bench/lexer <file> [seconds]
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "lexer.h"
+#include "scan.h"
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <file> [seconds]\n", argv[0]);
+        return 1;
+    }
+    double budget = (argc > 2) ? atof(argv[2]) : 1.0;
+
+    FILE* file = fopen(argv[1], "rb");
+    if (file == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* source = malloc(length + 1);
+    if (fread(source, 1, length, file) != (size_t) length) {
+        perror(argv[1]);
+        return 1;
+    }
+    source[length] = '\0';
+    fclose(file);
+
+    unsigned long tokens = 0;
+    unsigned long checksum = 0;
+    unsigned long runs = 0;
+    double start = now();
+    double elapsed;
+    do {
+        LexerState lexer;
+        lexer_init(&lexer, source, length);
+        for (Token token = lexer_next_token(&lexer); token.type != TOKEN_EOF; token = lexer_next_token(&lexer)) {
+            if (runs == 0) {
+                tokens += 1;
+                checksum = checksum * 31 + token.type * 7919 + token.offset * 131 + token.length;
+            }
+        }
+        runs += 1;
+        elapsed = now() - start;
+    } while (elapsed < budget);
+
+    printf("%lu tokens, checksum %016lx, %.1f MB/s (%s)\n", tokens, checksum, (double) length * runs / elapsed / 1e6, scan_kernel());
+    free(source);
+    return 0;
+}
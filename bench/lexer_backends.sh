@@ -0,0 +1,32 @@
+#!/bin/sh
+# Compare the goto and table lexer backends: code size of regex_dfa.o,
+# throughput on the test programs (as they are and indented the way
+# generated code is) with every scanner kernel, and whether they all
+# agree on the tokens.
+# Regenerates src/*.c along the way; the goto backend is left in place.
+#
+#   sh bench/lexer_backends.sh [cc] [seconds]
+set -e
+CC=${1:-cc}
+SECONDS_PER_RUN=${2:-1}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+# a few MB so the loop does not live in L1
+for i in $(seq 1 200); do cat tests/*.hk; done > "$OUT/plain.hk"
+sed 's/^/                /' "$OUT/plain.hk" > "$OUT/indented.hk"
+echo "corpus: $(wc -c < "$OUT/plain.hk") bytes plain, $(wc -c < "$OUT/indented.hk") indented"
+
+for backend in goto table; do
+    python src/main.py --lexer-backend=$backend > /dev/null
+    $CC -O2 -c src/regex_dfa.c -o "$OUT/regex_dfa.o"
+    $CC -O2 -Isrc bench/lexer.c src/lexer.c src/regex_dfa.c src/scan.c -o "$OUT/lexer_$backend"
+    echo "$backend: regex_dfa.o $(size "$OUT/regex_dfa.o" | awk 'NR == 2 {print $1 " text, " $2 " data"}')"
+    for kernel in scalar sse2 avx2; do
+        for corpus in plain indented; do
+            echo "  $kernel $corpus: $(HELK_SCAN=$kernel "$OUT/lexer_$backend" "$OUT/$corpus.hk" "$SECONDS_PER_RUN")"
+        done
+    done
+done
+
+python src/main.py > /dev/null
@@ -0,0 +1,169 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define CHUNK_SIZE (256 * 1024)
+#define ALIGNMENT 16
+#define ALIGN(n) (((n) + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1))
+
+// every allocation remembers its capacity so realloc can work
+typedef struct {
+    size_t capacity;
+    size_t padding;
+} Header;
+
+static _Thread_local Arena* current = NULL;
+
+void arena_init(Arena* arena) {
+    arena->head = NULL;
+    arena->allocated = 0;
+}
+
+void arena_release(Arena* arena) {
+    ArenaChunk* chunk = arena->head;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+    arena->allocated = 0;
+}
+
+static ArenaChunk* new_chunk(size_t size) {
+    ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + size);
+    if (chunk == NULL) {
+        abort();
+    }
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    // no chunk can hold it, and the sums below would wrap
+    if (size > SIZE_MAX / 2) {
+        abort();
+    }
+    size_t capacity = ALIGN(size ? size : 1);
+    size_t needed = sizeof(Header) + capacity;
+
+    ArenaChunk* chunk = arena->head;
+    if (chunk == NULL || chunk->used + needed > chunk->size) {
+        if (needed > CHUNK_SIZE / 4) {
+            // big blocks get a chunk of their own behind the current one
+            // so the space left in it is not wasted
+            chunk = new_chunk(needed);
+            if (arena->head) {
+                chunk->next = arena->head->next;
+                arena->head->next = chunk;
+            }
+            else {
+                chunk->next = NULL;
+                arena->head = chunk;
+            }
+        }
+        else {
+            chunk = new_chunk(CHUNK_SIZE);
+            chunk->next = arena->head;
+            arena->head = chunk;
+        }
+    }
+
+    Header* header = (Header*) (chunk->data + chunk->used);
+    header->capacity = capacity;
+    chunk->used += needed;
+    arena->allocated += capacity;
+    return header + 1;
+}
+
+void arena_merge(Arena* into, Arena* from) {
+    if (from->head == NULL) {
+        return;
+    }
+    ArenaChunk* last = from->head;
+    while (last->next) {
+        last = last->next;
+    }
+    // behind the head of into, which keeps taking the allocations
+    if (into->head) {
+        last->next = into->head->next;
+        into->head->next = from->head;
+    }
+    else {
+        into->head = from->head;
+    }
+    into->allocated += from->allocated;
+    from->head = NULL;
+    from->allocated = 0;
+}
+
+static void* arena_realloc(Arena* arena, void* pointer, size_t size) {
+    if (pointer == NULL) {
+        return arena_alloc(arena, size);
+    }
+    Header* header = (Header*) pointer - 1;
+    if (size <= header->capacity) {
+        return pointer;
+    }
+
+    // the last allocation of the chunk can grow in place
+    ArenaChunk* chunk = arena->head;
+    size_t capacity = ALIGN(size);
+    if ((char*) pointer + header->capacity == chunk->data + chunk->used
+        && chunk->used + (capacity - header->capacity) <= chunk->size) {
+        chunk->used += capacity - header->capacity;
+        arena->allocated += capacity - header->capacity;
+        header->capacity = capacity;
+        return pointer;
+    }
+
+    void* result = arena_alloc(arena, size);
+    memcpy(result, pointer, header->capacity);
+    return result;
+}
+
+void arena_set_current(Arena* arena) {
+    current = arena;
+}
+
+void* hk_malloc(size_t size) {
+    return current ? arena_alloc(current, size) : malloc(size);
+}
+
+void* hk_calloc(size_t count, size_t size) {
+    if (!current) {
+        return calloc(count, size);
+    }
+    size_t total;
+    if (__builtin_mul_overflow(count, size, &total)) {
+        abort();
+    }
+    void* result = arena_alloc(current, total);
+    memset(result, 0, total);
+    return result;
+}
+
+void* hk_realloc(void* pointer, size_t size) {
+    return current ? arena_realloc(current, pointer, size) : realloc(pointer, size);
+}
+
+char* hk_strdup(const char* s) {
+    return hk_strndup(s, strlen(s));
+}
+
+char* hk_strndup(const char* s, size_t n) {
+    size_t length = strnlen(s, n);
+    char* result = hk_malloc(length + 1);
+    memcpy(result, s, length);
+    result[length] = '\0';
+    return result;
+}
+
+void hk_free(void* pointer) {
+    // arena memory goes away with the compilation
+    if (!current) {
+        free(pointer);
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Region allocator: bump allocations out of big chunks and drop
+// everything at once. Every compilation owns one.
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t size;
+    size_t used;
+    _Alignas(16) char data[];
+} ArenaChunk;
+
+typedef struct {
+    ArenaChunk* head;
+    size_t allocated; // bytes handed out, for the logs
+} Arena;
+
+void arena_init(Arena* arena);
+void arena_release(Arena* arena);
+void* arena_alloc(Arena* arena, size_t size);
+// Hand everything in from over to into (from is left empty)
+void arena_merge(Arena* into, Arena* from);
+
+// Allocations on this thread go to this arena (NULL for the heap)
+void arena_set_current(Arena* arena);
+
+/*
+ * Drop-in replacements for the libc allocator used by the compiler.
+ * Inside a compilation they allocate from its arena and hk_free does
+ * nothing; outside of one (the server's prelude, tools) they are plain
+ * malloc and friends.
+ */
+void* hk_malloc(size_t size);
+void* hk_calloc(size_t count, size_t size);
+void* hk_realloc(void* pointer, size_t size);
+char* hk_strdup(const char* s);
+char* hk_strndup(const char* s, size_t n);
+void hk_free(void* pointer);
+
+#endif
@@ -1,16 +1,18 @@
 #include "ast.h"
+#include "log.h"
+#include "arena.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
 
 ASTNode *create_ast_block(ASTNode **block, unsigned int stmt_count) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = hk_calloc(1, sizeof(ASTNode));
     node->type = AST_BLOCK;
 
     // shallow copy again again
     if (block != NULL) {
-        node->block.statements = malloc(sizeof(ASTNode*) * stmt_count);
+        node->block.statements = hk_malloc(sizeof(ASTNode*) * stmt_count);
         memcpy(node->block.statements, block, sizeof(ASTNode*) * stmt_count);
     }
     else {
@@ -28,13 +30,15 @@ ASTNode *create_ast_block(ASTNode **block, unsigned int stmt_count) {
 }
 
 ASTNode *create_ast_param_list(char **params, unsigned int count) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = hk_calloc(1, sizeof(ASTNode));
     // not used
     node->type = 42;
 
     // shallow copy again again again
-    node->param_list.params = malloc(sizeof(char*) * count);
-    memcpy(node->param_list.params, params, sizeof(char*) * count);
+    node->param_list.params = hk_malloc(sizeof(char*) * count);
+    if (count > 0) {
+        memcpy(node->param_list.params, params, sizeof(char*) * count);
+    }
 
     node->param_list.count = count;
 
@@ -47,16 +51,18 @@ ASTNode *create_ast_param_list(char **params, unsigned int count) {
 }
 
 ASTNode* create_ast_variable_list(char **names, ASTNode **values, unsigned int count) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = hk_calloc(1, sizeof(ASTNode));
     // not used
     node->type = 69;
 
     // shallow copy again again again
-    node->variable_list.names = malloc(sizeof(char*) * count);
-    memcpy(node->variable_list.names, names, sizeof(char*) * count);
+    node->variable_list.names = hk_malloc(sizeof(char*) * count);
+    if (count > 0) {
+        memcpy(node->variable_list.names, names, sizeof(char*) * count);
+    }
 
     if (values != NULL) {
-        node->variable_list.values = malloc(sizeof(ASTNode*) * count);
+        node->variable_list.values = hk_malloc(sizeof(ASTNode*) * count);
         memcpy(node->variable_list.values, values, sizeof(ASTNode*) * count);
     }
     else {
@@ -73,15 +79,77 @@ ASTNode* create_ast_variable_list(char **names, ASTNode **values, unsigned int c
     return node;
 }
 
+// Room for one more item: the array holds count rounded up to a power
+// of two, so it doubles when count gets there
+static void* list_grow(void* items, unsigned int count, size_t size) {
+    if ((count & (count - 1)) != 0) {
+        return items;
+    }
+    return hk_realloc(items, size * (count == 0 ? 1 : 2 * (size_t) count));
+}
+
+// Reverse the first count items of an array of pointers
+static void list_reverse(void** items, unsigned int count) {
+    for (unsigned int i = 0, j = count; i + 1 < j; i++, j--) {
+        void* item = items[i];
+        items[i] = items[j - 1];
+        items[j - 1] = item;
+    }
+}
+
+ASTNode* ast_block_push(ASTNode* block, ASTNode* statement) {
+    if (block == NULL) {
+        block = create_ast_block(NULL, 0);
+    }
+    block->block.statements = list_grow(block->block.statements, block->block.stmt_count, sizeof(ASTNode*));
+    block->block.statements[block->block.stmt_count++] = statement;
+    return block;
+}
+
+void ast_block_reverse(ASTNode* block) {
+    list_reverse((void**) block->block.statements, block->block.stmt_count);
+}
+
+ASTNode* ast_param_list_push(ASTNode* list, char* param) {
+    if (list == NULL) {
+        list = create_ast_param_list(NULL, 0);
+    }
+    list->param_list.params = list_grow(list->param_list.params, list->param_list.count, sizeof(char*));
+    list->param_list.params[list->param_list.count++] = param;
+    return list;
+}
+
+void ast_param_list_reverse(ASTNode* list) {
+    list_reverse((void**) list->param_list.params, list->param_list.count);
+}
+
+ASTNode* ast_variable_list_push(ASTNode* list, char* name, ASTNode* value) {
+    if (list == NULL) {
+        list = create_ast_variable_list(NULL, NULL, 0);
+    }
+    unsigned int count = list->variable_list.count;
+    list->variable_list.names = list_grow(list->variable_list.names, count, sizeof(char*));
+    list->variable_list.values = list_grow(list->variable_list.values, count, sizeof(ASTNode*));
+    list->variable_list.names[count] = name;
+    list->variable_list.values[count] = value;
+    list->variable_list.count = count + 1;
+    return list;
+}
+
+void ast_variable_list_reverse(ASTNode* list) {
+    list_reverse((void**) list->variable_list.names, list->variable_list.count);
+    list_reverse((void**) list->variable_list.values, list->variable_list.count);
+}
+
 ASTNode* create_ast_let_in(char **names, ASTNode **values, unsigned int count, ASTNode *body) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = hk_calloc(1, sizeof(ASTNode));
     node->type = AST_LET_IN;
 
     // shallow copy again again again
-    node->let_in.var_names = malloc(sizeof(char*) * count);
+    node->let_in.var_names = hk_malloc(sizeof(char*) * count);
     memcpy(node->let_in.var_names, names, sizeof(char*) * count);
 
-    node->let_in.var_values = malloc(sizeof(ASTNode*) * count);
+    node->let_in.var_values = hk_malloc(sizeof(ASTNode*) * count);
     memcpy(node->let_in.var_values, values, sizeof(ASTNode*) * count);
 
     node->let_in.var_count = count;
@@ -97,7 +165,7 @@ ASTNode* create_ast_let_in(char **names, ASTNode **values, unsigned int count, A
 
 
 ASTNode* create_ast_while_loop(ASTNode* cond, ASTNode* body) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = hk_calloc(1, sizeof(ASTNode));
     node->type = AST_WHILE_LOOP;
 
     node->while_loop.cond = cond;
@@ -112,7 +180,7 @@ ASTNode* create_ast_while_loop(ASTNode* cond, ASTNode* body) {
 }
 
 ASTNode* create_ast_conditional(ASTNode* hypothesis, ASTNode* thesis, ASTNode* antithesis) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = hk_calloc(1, sizeof(ASTNode));
     node->type = AST_CONDITIONAL;
 
     // we are not leaking memory
@@ -132,9 +200,9 @@ ASTNode* create_ast_conditional(ASTNode* hypothesis, ASTNode* thesis, ASTNode* a
 
 // Create field definition
 ASTNode* create_ast_field_def(char* name, ASTNode* default_value) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = hk_calloc(1, sizeof(ASTNode));
     node->type = AST_FIELD_DEF;
-    node->field_def.name = strdup(name);
+    node->field_def.name = name;
     node->field_def.default_value = default_value;
 
     node->type_info.kind = TYPE_UNKNOWN;
@@ -158,13 +226,13 @@ ASTNode* create_ast_type_def(char* name, char* base_type,
     }
 
     // Allocate type definition
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = hk_calloc(1, sizeof(ASTNode));
     node->type = AST_TYPE_DEF;
-    node->type_decl.name = strdup(name);
-    node->type_decl.base_type = base_type ? strdup(base_type) : NULL;
-    node->type_decl.fields = malloc(sizeof(ASTNode*) * field_count);
+    node->type_decl.name = name;
+    node->type_decl.base_type = base_type;
+    node->type_decl.fields = hk_malloc(sizeof(ASTNode*) * field_count);
     node->type_decl.field_count = field_count;
-    node->type_decl.methods = malloc(sizeof(ASTNode*) * method_count);
+    node->type_decl.methods = hk_malloc(sizeof(ASTNode*) * method_count);
     node->type_decl.method_count = method_count;
 
     // Populate fields and methods
@@ -186,12 +254,12 @@ ASTNode* create_ast_type_def(char* name, char* base_type,
 }
 
 ASTNode *create_ast_constructor(char* cls, ASTNode **args, unsigned int arg_count) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = hk_calloc(1, sizeof(ASTNode));
     node->type = AST_CONSTRUCTOR;
-    node->constructor.cls = strdup(cls);
+    node->constructor.cls = cls;
 
     // shallow copy again
-    node->constructor.args = malloc(sizeof(ASTNode*) * arg_count);
+    node->constructor.args = hk_malloc(sizeof(ASTNode*) * arg_count);
     memcpy(node->constructor.args, args, sizeof(ASTNode*) * arg_count);
     node->constructor.arg_count = arg_count;
 
@@ -203,10 +271,10 @@ ASTNode *create_ast_constructor(char* cls, ASTNode **args, unsigned int arg_coun
     return node;
 }
 ASTNode *create_ast_field_access(char* cls, char* field) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = hk_calloc(1, sizeof(ASTNode));
     node->type = AST_FIELD_ACCESS;
-    node->field_access.cls = strdup(cls);
-    node->field_access.field = strdup(field);
+    node->field_access.cls = cls;
+    node->field_access.field = field;
 
     //node->field_access.pos = 69;
     node->field_access.pos = 0;
@@ -221,10 +289,10 @@ ASTNode *create_ast_field_access(char* cls, char* field) {
 
 
 ASTNode *create_ast_field_reassign(ASTNode* field_access, char* value) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = hk_calloc(1, sizeof(ASTNode));
     node->type = AST_FIELD_REASSIGN;
     node->field_reassign.field_access = field_access;
-    node->field_reassign.value = strdup(value);
+    node->field_reassign.value = value;
 
     node->type_info.kind = TYPE_UNKNOWN;
     node->type_info.name = NULL;
@@ -235,14 +303,14 @@ ASTNode *create_ast_field_reassign(ASTNode* field_access, char* value) {
 }
 
 ASTNode *create_ast_method_call(ASTNode* cls, char* method, ASTNode **args, unsigned int arg_count) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = hk_calloc(1, sizeof(ASTNode));
     node->type = AST_METHOD_CALL;
 
     node->method_call.cls = cls;
-    node->method_call.method = strdup(method);
+    node->method_call.method = method;
 
     if (arg_count != 0) {
-        node->method_call.args = malloc(sizeof(ASTNode*) * arg_count);
+        node->method_call.args = hk_malloc(sizeof(ASTNode*) * arg_count);
         memcpy(node->method_call.args, args, sizeof(ASTNode*) * arg_count);
     }
     else {
@@ -262,9 +330,9 @@ ASTNode *create_ast_method_call(ASTNode* cls, char* method, ASTNode **args, unsi
 }
 
 ASTNode *create_ast_variable_def(char *name, ASTNode *body) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = hk_calloc(1, sizeof(ASTNode));
     node->type = AST_VARIABLE_DEF;
-    node->variable_def.name = strdup(name);
+    node->variable_def.name = name;
     node->variable_def.body = body;
 
     node->type_info.kind = TYPE_UNKNOWN;
@@ -276,9 +344,9 @@ ASTNode *create_ast_variable_def(char *name, ASTNode *body) {
 }
 
 ASTNode *create_ast_variable(char *name) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = hk_calloc(1, sizeof(ASTNode));
     node->type = AST_VARIABLE;
-    node->variable.name = strdup(name);
+    node->variable.name = name;
 
     node->type_info.kind = TYPE_UNKNOWN;
     node->type_info.name = NULL;
@@ -289,14 +357,14 @@ ASTNode *create_ast_variable(char *name) {
 }
 
 ASTNode *create_ast_function_def(char *name, ASTNode *body, char **args, unsigned int arg_count) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = hk_calloc(1, sizeof(ASTNode));
     node->type = AST_FUNCTION_DEF;
-    node->function_def.name = strdup(name);
+    node->function_def.name = name;
     node->function_def.body = body;
 
     // shallow copy again
-    node->function_def.args_definitions = malloc(sizeof(ASTNode*) * arg_count);
-    node->function_def.args = malloc(sizeof(ASTNode*) * arg_count);
+    node->function_def.args_definitions = hk_malloc(sizeof(ASTNode*) * arg_count);
+    node->function_def.args = hk_malloc(sizeof(ASTNode*) * arg_count);
     memcpy(node->function_def.args, args, sizeof(ASTNode*) * arg_count);
     node->function_def.arg_count = arg_count;
 
@@ -315,12 +383,12 @@ ASTNode *create_ast_function_def(char *name, ASTNode *body, char **args, unsigne
 }
 
 ASTNode *create_ast_function_call(char *name, ASTNode **args, unsigned int arg_count) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = hk_calloc(1, sizeof(ASTNode));
     node->type = AST_FUNCTION_CALL;
-    node->function_call.name = strdup(name);
+    node->function_call.name = name;
 
     // shallow copy
-    node->function_call.args = malloc(sizeof(ASTNode*) * arg_count);
+    node->function_call.args = hk_malloc(sizeof(ASTNode*) * arg_count);
     memcpy(node->function_call.args, args, sizeof(ASTNode*) * arg_count);
     node->function_call.arg_count = arg_count;
 
@@ -336,7 +404,7 @@ ASTNode *create_ast_function_call(char *name, ASTNode **args, unsigned int arg_c
 
 
 ASTNode *create_ast_number(double value) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = hk_calloc(1, sizeof(ASTNode));
     node->type = AST_NUMBER;
     node->number = value;
 
@@ -350,10 +418,10 @@ ASTNode *create_ast_number(double value) {
 }
 
 ASTNode *create_ast_string(char* ptr) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = hk_calloc(1, sizeof(ASTNode));
 
     node->type = AST_STRING;
-    node->string = strdup(ptr);
+    node->string = ptr;
 
     node->type_info.kind = TYPE_UNKNOWN;
     node->type_info.name = NULL;
@@ -364,7 +432,7 @@ ASTNode *create_ast_string(char* ptr) {
 }
 
 ASTNode *create_ast_binary_op(ASTNode *left, ASTNode *right, ASTBinaryOp op) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = hk_calloc(1, sizeof(ASTNode));
     node->type = AST_BINARY_OP;
     node->binary_op.left = left;
     node->binary_op.right = right;
@@ -384,8 +452,8 @@ void free_ast(ASTNode *node) {
     }
 
     // Free type_info strings
-    free(node->type_info.name);
-    free(node->type_info.cls);
+    hk_free(node->type_info.name);
+    hk_free(node->type_info.cls);
 
     switch (node->type) {
         case AST_NUMBER:
@@ -393,11 +461,11 @@ void free_ast(ASTNode *node) {
             break;
             
         case AST_STRING:
-            free(node->string);
+            hk_free(node->string);
             break;
             
         case AST_VARIABLE:
-            free(node->variable.name);
+            hk_free(node->variable.name);
             break;
             
         case AST_BINARY_OP:
@@ -407,27 +475,27 @@ void free_ast(ASTNode *node) {
             
         case AST_FUNCTION_DEF:
         case AST_METHOD_DEF:
-            free(node->function_def.name);
+            hk_free(node->function_def.name);
             // Free args array (container only, strings owned by arg nodes)
-            free(node->function_def.args);
+            hk_free(node->function_def.args);
             // Free argument definition nodes
             for (unsigned int i = 0; i < node->function_def.arg_count; i++) {
                 free_ast(node->function_def.args_definitions[i]);
             }
-            free(node->function_def.args_definitions);
+            hk_free(node->function_def.args_definitions);
             free_ast(node->function_def.body);
             break;
             
         case AST_FUNCTION_CALL:
-            free(node->function_call.name);
+            hk_free(node->function_call.name);
             for (unsigned int i = 0; i < node->function_call.arg_count; i++) {
                 free_ast(node->function_call.args[i]);
             }
-            free(node->function_call.args);
+            hk_free(node->function_call.args);
             break;
             
         case AST_VARIABLE_DEF:
-            free(node->variable_def.name);
+            hk_free(node->variable_def.name);
             free_ast(node->variable_def.body);
             break;
             
@@ -435,16 +503,16 @@ void free_ast(ASTNode *node) {
             for (unsigned int i = 0; i < node->block.stmt_count; i++) {
                 free_ast(node->block.statements[i]);
             }
-            free(node->block.statements);
+            hk_free(node->block.statements);
             break;
             
         case AST_LET_IN:
             for (unsigned int i = 0; i < node->let_in.var_count; i++) {
-                free(node->let_in.var_names[i]);
+                hk_free(node->let_in.var_names[i]);
                 free_ast(node->let_in.var_values[i]);
             }
-            free(node->let_in.var_names);
-            free(node->let_in.var_values);
+            hk_free(node->let_in.var_names);
+            hk_free(node->let_in.var_values);
             free_ast(node->let_in.body);
             break;
             
@@ -460,43 +528,43 @@ void free_ast(ASTNode *node) {
             break;
             
         case AST_TYPE_DEF:
-            free(node->type_decl.name);
-            free(node->type_decl.base_type);
+            hk_free(node->type_decl.name);
+            hk_free(node->type_decl.base_type);
             for (unsigned int i = 0; i < node->type_decl.field_count; i++) {
                 free_ast(node->type_decl.fields[i]);
             }
-            free(node->type_decl.fields);
+            hk_free(node->type_decl.fields);
             for (unsigned int i = 0; i < node->type_decl.method_count; i++) {
                 free_ast(node->type_decl.methods[i]);
             }
-            free(node->type_decl.methods);
+            hk_free(node->type_decl.methods);
             break;
             
         case AST_FIELD_DEF:
-            free(node->field_def.name);
+            hk_free(node->field_def.name);
             free_ast(node->field_def.default_value);
             break;
             
         case AST_CONSTRUCTOR:
-            free(node->constructor.cls);
+            hk_free(node->constructor.cls);
             for (unsigned int i = 0; i < node->constructor.arg_count; i++) {
                 free_ast(node->constructor.args[i]);
             }
-            free(node->constructor.args);
+            hk_free(node->constructor.args);
             break;
             
         case AST_FIELD_ACCESS:
-            free(node->field_access.cls);
-            free(node->field_access.field);
+            hk_free(node->field_access.cls);
+            hk_free(node->field_access.field);
             break;
             
         case AST_METHOD_CALL:
             free_ast(node->method_call.cls);
-            free(node->method_call.method);
+            hk_free(node->method_call.method);
             for (unsigned int i = 0; i < node->method_call.arg_count; i++) {
                 free_ast(node->method_call.args[i]);
             }
-            free(node->method_call.args);
+            hk_free(node->method_call.args);
             break;
             
         default:
@@ -504,34 +572,34 @@ void free_ast(ASTNode *node) {
             break;
     }
     
-    free(node);
+    hk_free(node);
 }
 
 static void print_indent(int level) {
     for (int i = 0; i < level; i++) {
-        fprintf(stderr, "  ");
+        fprintf(log_file(), "  ");
     }
 }
 
 void ast_print_node(const ASTNode *node, int indent) {
     if (node == NULL) {
         print_indent(indent);
-        fprintf(stderr, "NULL\n");
+        fprintf(log_file(), "NULL\n");
         return;
     }
 
     switch (node->type) {
         case AST_NUMBER:
             print_indent(indent);
-            fprintf(stderr, "NUMBER: %f\n", node->number);
+            fprintf(log_file(), "NUMBER: %f\n", node->number);
             break;
         case AST_STRING:
             print_indent(indent);
-            fprintf(stderr, "STRING: \"%s\"\n", node->string ? node->string : "NULL");
+            fprintf(log_file(), "STRING: \"%s\"\n", node->string ? node->string : "NULL");
             break;
         case AST_VARIABLE:
             print_indent(indent);
-            fprintf(stderr, "VARIABLE: %s\n", node->variable.name ? node->variable.name : "NULL");
+            fprintf(log_file(), "VARIABLE: %s\n", node->variable.name ? node->variable.name : "NULL");
             break;
         case AST_BINARY_OP: {
             const char *op_str = "?";
@@ -544,194 +612,194 @@ void ast_print_node(const ASTNode *node, int indent) {
                 case OP_MOD: op_str = "%"; break;
             }
             print_indent(indent);
-            fprintf(stderr, "BINARY_OP: %s\n", op_str);
+            fprintf(log_file(), "BINARY_OP: %s\n", op_str);
             ast_print_node(node->binary_op.left, indent + 1);
             ast_print_node(node->binary_op.right, indent + 1);
             break;
         }
         case AST_FUNCTION_DEF: {
             print_indent(indent);
-            fprintf(stderr, "FUNCTION_DEF: %s\n", node->function_def.name ? node->function_def.name : "NULL");
+            fprintf(log_file(), "FUNCTION_DEF: %s\n", node->function_def.name ? node->function_def.name : "NULL");
             print_indent(indent);
-            fprintf(stderr, "  ARGUMENTS (%u):\n", node->function_def.arg_count);
+            fprintf(log_file(), "  ARGUMENTS (%u):\n", node->function_def.arg_count);
             for (size_t i = 0; i < node->function_def.arg_count; i++) {
                 if (node->function_def.args_definitions && node->function_def.args_definitions[i]) {
                     ast_print_node(node->function_def.args_definitions[i], indent + 2);
                 } else {
                     print_indent(indent + 2);
-                    fprintf(stderr, "NULL\n");
+                    fprintf(log_file(), "NULL\n");
                 }
             }
             print_indent(indent);
-            fprintf(stderr, "  BODY:\n");
+            fprintf(log_file(), "  BODY:\n");
             ast_print_node(node->function_def.body, indent + 2);
             break;
         }
         case AST_FUNCTION_CALL: {
             print_indent(indent);
-            fprintf(stderr, "FUNCTION_CALL: %s (%u args)\n", node->function_call.name ? node->function_call.name : "NULL", node->function_call.arg_count);
+            fprintf(log_file(), "FUNCTION_CALL: %s (%u args)\n", node->function_call.name ? node->function_call.name : "NULL", node->function_call.arg_count);
             for (size_t i = 0; i < node->function_call.arg_count; i++) {
                 if (node->function_call.args && node->function_call.args[i]) {
                     ast_print_node(node->function_call.args[i], indent + 1);
                 } else {
                     print_indent(indent + 1);
-                    fprintf(stderr, "NULL\n");
+                    fprintf(log_file(), "NULL\n");
                 }
             }
             break;
         }
         case AST_VARIABLE_DEF: {
             print_indent(indent);
-            fprintf(stderr, "VARIABLE_DEF: %s\n", node->variable_def.name ? node->variable_def.name : "NULL");
+            fprintf(log_file(), "VARIABLE_DEF: %s\n", node->variable_def.name ? node->variable_def.name : "NULL");
             ast_print_node(node->variable_def.body, indent + 1);
             break;
         }
         case AST_BLOCK: {
             print_indent(indent);
-            fprintf(stderr, "BLOCK: %u statements\n", node->block.stmt_count);
+            fprintf(log_file(), "BLOCK: %u statements\n", node->block.stmt_count);
             for (size_t i = 0; i < node->block.stmt_count; i++) {
                 if (node->block.statements && node->block.statements[i]) {
                     ast_print_node(node->block.statements[i], indent + 1);
                 } else {
                     print_indent(indent + 1);
-                    fprintf(stderr, "NULL\n");
+                    fprintf(log_file(), "NULL\n");
                 }
             }
             break;
         }
         case AST_LET_IN: {
             print_indent(indent);
-            fprintf(stderr, "LET_IN: %u variables\n", node->let_in.var_count);
+            fprintf(log_file(), "LET_IN: %u variables\n", node->let_in.var_count);
             for (size_t i = 0; i < node->let_in.var_count; i++) {
                 print_indent(indent + 1);
-                fprintf(stderr, "VAR: %s\n", node->let_in.var_names[i] ? node->let_in.var_names[i] : "NULL");
+                fprintf(log_file(), "VAR: %s\n", node->let_in.var_names[i] ? node->let_in.var_names[i] : "NULL");
                 ast_print_node(node->let_in.var_values[i], indent + 2);
             }
             print_indent(indent);
-            fprintf(stderr, "IN:\n");
+            fprintf(log_file(), "IN:\n");
             ast_print_node(node->let_in.body, indent + 1);
             break;
         }
         case AST_CONDITIONAL: {
             print_indent(indent);
-            fprintf(stderr, "CONDITIONAL:\n");
+            fprintf(log_file(), "CONDITIONAL:\n");
             print_indent(indent);
-            fprintf(stderr, "  HYPOTHESIS:\n");
+            fprintf(log_file(), "  HYPOTHESIS:\n");
             ast_print_node(node->conditional.hypothesis, indent + 2);
             print_indent(indent);
-            fprintf(stderr, "  THESIS:\n");
+            fprintf(log_file(), "  THESIS:\n");
             ast_print_node(node->conditional.thesis, indent + 2);
             print_indent(indent);
-            fprintf(stderr, "  ANTITHESIS:\n");
+            fprintf(log_file(), "  ANTITHESIS:\n");
             ast_print_node(node->conditional.antithesis, indent + 2);
             break;
         }
         case AST_WHILE_LOOP: {
             print_indent(indent);
-            fprintf(stderr, "WHILE_LOOP:\n");
+            fprintf(log_file(), "WHILE_LOOP:\n");
             print_indent(indent);
-            fprintf(stderr, "  CONDITION:\n");
+            fprintf(log_file(), "  CONDITION:\n");
             ast_print_node(node->while_loop.cond, indent + 2);
             print_indent(indent);
-            fprintf(stderr, "  BODY:\n");
+            fprintf(log_file(), "  BODY:\n");
             ast_print_node(node->while_loop.body, indent + 2);
             break;
         }
         case AST_TYPE_DEF: {
             print_indent(indent);
-            fprintf(stderr, "TYPE_DEF: %s\n", node->type_decl.name ? node->type_decl.name : "NULL");
+            fprintf(log_file(), "TYPE_DEF: %s\n", node->type_decl.name ? node->type_decl.name : "NULL");
             if (node->type_decl.base_type) {
                 print_indent(indent);
-                fprintf(stderr, "  BASE: %s\n", node->type_decl.base_type);
+                fprintf(log_file(), "  BASE: %s\n", node->type_decl.base_type);
             }
             print_indent(indent);
-            fprintf(stderr, "  FIELDS: %u\n", node->type_decl.field_count);
+            fprintf(log_file(), "  FIELDS: %u\n", node->type_decl.field_count);
             for (size_t i = 0; i < node->type_decl.field_count; i++) {
                 if (node->type_decl.fields && node->type_decl.fields[i]) {
                     ast_print_node(node->type_decl.fields[i], indent + 2);
                 } else {
                     print_indent(indent + 2);
-                    fprintf(stderr, "NULL\n");
+                    fprintf(log_file(), "NULL\n");
                 }
             }
             print_indent(indent);
-            fprintf(stderr, "  METHODS: %u\n", node->type_decl.method_count);
+            fprintf(log_file(), "  METHODS: %u\n", node->type_decl.method_count);
             for (size_t i = 0; i < node->type_decl.method_count; i++) {
                 if (node->type_decl.methods && node->type_decl.methods[i]) {
                     ast_print_node(node->type_decl.methods[i], indent + 2);
                 } else {
                     print_indent(indent + 2);
-                    fprintf(stderr, "NULL\n");
+                    fprintf(log_file(), "NULL\n");
                 }
             }
             break;
         }
         case AST_FIELD_DEF: {
             print_indent(indent);
-            fprintf(stderr, "FIELD_DEF: %s\n", node->field_def.name ? node->field_def.name : "NULL");
+            fprintf(log_file(), "FIELD_DEF: %s\n", node->field_def.name ? node->field_def.name : "NULL");
             if (node->field_def.default_value) {
                 print_indent(indent);
-                fprintf(stderr, "  DEFAULT:\n");
+                fprintf(log_file(), "  DEFAULT:\n");
                 ast_print_node(node->field_def.default_value, indent + 2);
             }
             break;
         }
         case AST_CONSTRUCTOR: {
             print_indent(indent);
-            fprintf(stderr, "CONSTRUCTOR: %s (%u args)\n", node->constructor.cls ? node->constructor.cls : "NULL", node->constructor.arg_count);
+            fprintf(log_file(), "CONSTRUCTOR: %s (%u args)\n", node->constructor.cls ? node->constructor.cls : "NULL", node->constructor.arg_count);
             for (size_t i = 0; i < node->constructor.arg_count; i++) {
                 if (node->constructor.args && node->constructor.args[i]) {
                     ast_print_node(node->constructor.args[i], indent + 1);
                 } else {
                     print_indent(indent + 1);
-                    fprintf(stderr, "NULL\n");
+                    fprintf(log_file(), "NULL\n");
                 }
             }
             break;
         }
         case AST_FIELD_ACCESS: {
             print_indent(indent);
-            fprintf(stderr, "FIELD_ACCESS: %s.%s\n", node->field_access.cls ? node->field_access.cls : "NULL", node->field_access.field ? node->field_access.field : "NULL");
+            fprintf(log_file(), "FIELD_ACCESS: %s.%s\n", node->field_access.cls ? node->field_access.cls : "NULL", node->field_access.field ? node->field_access.field : "NULL");
             break;
         }
         case AST_METHOD_CALL: {
             print_indent(indent);
-            fprintf(stderr, "METHOD_CALL: %s.%s (%u args)\n",
+            fprintf(log_file(), "METHOD_CALL: %s.%s (%u args)\n",
                     node->method_call.cls->variable.name,
                     node->method_call.method ? node->method_call.method : "NULL",
                     node->method_call.arg_count);
             print_indent(indent);
-            fprintf(stderr, "  OBJECT:\n");
+            fprintf(log_file(), "  OBJECT:\n");
             ast_print_node(node->method_call.cls, indent + 2);
             for (size_t i = 0; i < node->method_call.arg_count; i++) {
                 if (node->method_call.args && node->method_call.args[i]) {
                     ast_print_node(node->method_call.args[i], indent + 1);
                 } else {
                     print_indent(indent + 1);
-                    fprintf(stderr, "NULL\n");
+                    fprintf(log_file(), "NULL\n");
                 }
             }
             break;
         }
         case AST_METHOD_DEF:
             print_indent(indent);
-            fprintf(stderr, "METHOD: %s\n", node->function_def.name ? node->function_def.name : "NULL");
+            fprintf(log_file(), "METHOD: %s\n", node->function_def.name ? node->function_def.name : "NULL");
             print_indent(indent);
-            fprintf(stderr, "  ARGUMENTS (%u):\n", node->function_def.arg_count);
+            fprintf(log_file(), "  ARGUMENTS (%u):\n", node->function_def.arg_count);
             for (size_t i = 0; i < node->function_def.arg_count; i++) {
                 if (node->function_def.args_definitions && node->function_def.args_definitions[i]) {
                     ast_print_node(node->function_def.args_definitions[i], indent + 2);
                 } else {
                     print_indent(indent + 2);
-                    fprintf(stderr, "NULL\n");
+                    fprintf(log_file(), "NULL\n");
                 }
             }
             print_indent(indent);
-            fprintf(stderr, "  BODY:\n");
+            fprintf(log_file(), "  BODY:\n");
             ast_print_node(node->function_def.body, indent + 2);
             break;
         default:
             print_indent(indent);
-            fprintf(stderr, "UNKNOWN_NODE_TYPE: %d\n", node->type);
+            fprintf(log_file(), "UNKNOWN_NODE_TYPE: %d\n", node->type);
     }
 }
@@ -53,8 +53,7 @@ typedef enum {
 typedef struct ASTNode {
     ASTNodeType type;
     TypeInfo type_info;
-    unsigned int line;
-    unsigned int column;
+    unsigned int offset; // into the source, see lines.h
     unsigned int type_var_id;  // Index in constraint system
     union {
         double number;
@@ -150,6 +149,7 @@ typedef struct ASTNode {
     };
 } ASTNode;
 
+// NOTE: names and strings are adopted by the node, not copied
 ASTNode* create_ast_block(ASTNode **block, unsigned int stmt_count);
 ASTNode* create_ast_string(char* ptr);
 ASTNode* create_ast_number(double value);
@@ -171,6 +171,22 @@ ASTNode *create_ast_field_reassign(ASTNode* field_access, char* value);
 ASTNode* create_ast_param_list(char **params, unsigned int count);
 ASTNode* create_ast_variable_list(char **names, ASTNode **values, unsigned int count);
 
+/*
+ * The grammar is right recursive, so its actions see the items of a list
+ * last to first. The tails push them onto the end of an array that
+ * doubles as it fills, and the head of the list reverses it once: n items
+ * cost O(n) copies, not a fresh array per item. Push only onto lists
+ * that started out empty. An empty tail is NULL (as is one lost to a
+ * syntax error): pushing onto NULL starts a new list, and push returns
+ * the list.
+ */
+ASTNode* ast_block_push(ASTNode* block, ASTNode* statement);
+void ast_block_reverse(ASTNode* block);
+ASTNode* ast_param_list_push(ASTNode* list, char* param);
+void ast_param_list_reverse(ASTNode* list);
+ASTNode* ast_variable_list_push(ASTNode* list, char* name, ASTNode* value);
+void ast_variable_list_reverse(ASTNode* list);
+
 void free_ast(ASTNode *node);
 void ast_print_node(const ASTNode *node, int indent);
 
@@ -0,0 +1,232 @@
+#include "backend.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef HELK_RUNTIME
+#define HELK_RUNTIME "src/builtins.o"
+#endif
+#ifndef HELK_LINKER
+#define HELK_LINKER "cc"
+#endif
+
+static const char* kind_names[] = {
+    [EMIT_LL] = "ll",
+    [EMIT_BC] = "bc",
+    [EMIT_OBJ] = "obj",
+    [EMIT_EXE] = "exe",
+};
+
+static const char* extensions[] = {
+    [EMIT_LL] = ".ll",
+    [EMIT_BC] = ".bc",
+    [EMIT_OBJ] = ".o",
+    [EMIT_EXE] = "",
+};
+
+bool emit_parse_kind(const char* name, EmitKind* kind) {
+    for (size_t i = 0; i < sizeof(kind_names) / sizeof(kind_names[0]); i++) {
+        if (strcmp(name, kind_names[i]) == 0) {
+            *kind = (EmitKind) i;
+            return true;
+        }
+    }
+    fprintf(stderr, "Error: Unknown output kind '%s' (ll, bc, obj or exe)\n", name);
+    return false;
+}
+
+const char* emit_extension(EmitKind kind) {
+    return extensions[kind];
+}
+
+#ifdef HELK_LLVM
+
+#include <unistd.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/Target.h>
+#include <llvm-c/TargetMachine.h>
+
+extern char** environ;
+
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static void init_targets(void) {
+    LLVMInitializeNativeTarget();
+    LLVMInitializeNativeAsmPrinter();
+}
+
+static LLVMTargetMachineRef create_target_machine(const EmitOptions* options, FILE* diagnostics) {
+    char* triple = LLVMGetDefaultTargetTriple();
+    char* message = NULL;
+    LLVMTargetRef target;
+    if (LLVMGetTargetFromTriple(triple, &target, &message)) {
+        fprintf(diagnostics, "Error: No target for '%s': %s\n", triple, message);
+        LLVMDisposeMessage(message);
+        LLVMDisposeMessage(triple);
+        return NULL;
+    }
+
+    // like llc, generic unless asked otherwise
+    bool native = options->cpu != NULL && strcmp(options->cpu, "native") == 0;
+    char* cpu = native ? LLVMGetHostCPUName() : LLVMCreateMessage(options->cpu ? options->cpu : "generic");
+    char* features = (native && options->features == NULL)
+        ? LLVMGetHostCPUFeatures()
+        : LLVMCreateMessage(options->features ? options->features : "");
+
+    // PIC so the objects also link into the default PIE executables
+    LLVMTargetMachineRef machine = LLVMCreateTargetMachine(
+        target,
+        triple,
+        cpu,
+        features,
+        LLVMCodeGenLevelDefault,
+        LLVMRelocPIC,
+        LLVMCodeModelDefault
+    );
+    LLVMDisposeMessage(features);
+    LLVMDisposeMessage(cpu);
+    LLVMDisposeMessage(triple);
+    return machine;
+}
+
+static bool link_executable(const char* object, const char* path, const EmitOptions* options, FILE* diagnostics) {
+    const char* runtime = options->runtime ? options->runtime : HELK_RUNTIME;
+    char* argv[] = {
+        HELK_LINKER,
+        (char*) object,
+        (char*) runtime,
+        "-lm",
+        "-o",
+        (char*) path,
+        NULL,
+    };
+
+    pid_t pid;
+    int status;
+    if (posix_spawnp(&pid, HELK_LINKER, NULL, NULL, argv, environ) != 0) {
+        fprintf(diagnostics, "Error: Could not run the linker '%s'\n", HELK_LINKER);
+        return false;
+    }
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(diagnostics, "Error: Linking '%s' with '%s' failed\n", path, runtime);
+        return false;
+    }
+    return true;
+}
+
+static bool emit_module(LLVMModuleRef module, const char* path, const EmitOptions* options, FILE* diagnostics) {
+    char* message = NULL;
+    if (options->kind == EMIT_LL) {
+        if (LLVMPrintModuleToFile(module, path, &message)) {
+            fprintf(diagnostics, "Error: Could not write '%s': %s\n", path, message);
+            LLVMDisposeMessage(message);
+            return false;
+        }
+        return true;
+    }
+    pthread_once(&once, init_targets);
+
+    LLVMTargetMachineRef machine = create_target_machine(options, diagnostics);
+    if (machine == NULL) {
+        return false;
+    }
+    char* triple = LLVMGetTargetMachineTriple(machine);
+    LLVMSetTarget(module, triple);
+    LLVMDisposeMessage(triple);
+    LLVMTargetDataRef layout = LLVMCreateTargetDataLayout(machine);
+    LLVMSetModuleDataLayout(module, layout);
+    LLVMDisposeTargetData(layout);
+
+    bool ok = false;
+    if (options->kind == EMIT_BC) {
+        ok = LLVMWriteBitcodeToFile(module, path) == 0;
+        if (!ok) {
+            fprintf(diagnostics, "Error: Could not write '%s'\n", path);
+        }
+        LLVMDisposeTargetMachine(machine);
+        return ok;
+    }
+
+    // executables are linked from a temporary object
+    char temporary[] = "/tmp/helk-XXXXXX.o";
+    const char* object = path;
+    if (options->kind == EMIT_EXE) {
+        int fd = mkstemps(temporary, 2);
+        if (fd < 0) {
+            fprintf(diagnostics, "Error: Could not create a temporary object file\n");
+            LLVMDisposeTargetMachine(machine);
+            return false;
+        }
+        close(fd);
+        object = temporary;
+    }
+
+    if (LLVMTargetMachineEmitToFile(machine, module, (char*) object, LLVMObjectFile, &message)) {
+        fprintf(diagnostics, "Error: Could not write '%s': %s\n", object, message);
+        LLVMDisposeMessage(message);
+    }
+    else {
+        ok = (options->kind == EMIT_EXE) ? link_executable(object, path, options, diagnostics) : true;
+    }
+
+    if (options->kind == EMIT_EXE) {
+        unlink(temporary);
+    }
+    LLVMDisposeTargetMachine(machine);
+    return ok;
+}
+
+bool emit_file(Compilation* compilation, const char* path, const EmitOptions* options, FILE* diagnostics) {
+    // one context per call, batch workers emit in parallel
+    LLVMContextRef context = LLVMContextCreate();
+    compilation->llvm = context;
+    bool ok = compile_file(compilation);
+    compilation->llvm = NULL;
+
+    if (ok) {
+        ok = emit_module(compilation->module, path, options, diagnostics);
+        LLVMDisposeModule(compilation->module);
+        compilation->module = NULL;
+    }
+    LLVMContextDispose(context);
+    return ok;
+}
+
+#else
+
+static bool write_ir(const char* ir, size_t length, const char* path, FILE* diagnostics) {
+    FILE* file = fopen(path, "w");
+    bool ok = file != NULL && fwrite(ir, 1, length, file) == length;
+    if (file != NULL && fclose(file) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        fprintf(diagnostics, "Error: Could not write '%s'\n", path);
+    }
+    return ok;
+}
+
+bool emit_file(Compilation* compilation, const char* path, const EmitOptions* options, FILE* diagnostics) {
+    if (options->kind != EMIT_LL) {
+        fprintf(diagnostics, "Error: --emit=%s needs a compiler built with LLVM (see LLVM_CONFIG in the Makefile)\n", kind_names[options->kind]);
+        return false;
+    }
+    char* ir = NULL;
+    size_t ir_size = 0;
+    compilation->output = open_memstream(&ir, &ir_size);
+    bool ok = compile_file(compilation);
+    fclose(compilation->output);
+    compilation->output = NULL;
+
+    // nothing is written for inputs that failed
+    if (ok) {
+        ok = write_ir(ir, ir_size, path, diagnostics);
+    }
+    free(ir);
+    return ok;
+}
+
+#endif
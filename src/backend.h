@@ -0,0 +1,36 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "compiler.h"
+
+typedef enum {
+    EMIT_LL,
+    EMIT_BC,
+    EMIT_OBJ,
+    EMIT_EXE, // linked with the runtime (builtins.o)
+} EmitKind;
+
+typedef struct {
+    EmitKind kind;
+    const char* cpu;      // NULL for generic, "native" for this machine
+    const char* features; // "+avx2,-fma" and so on
+    const char* runtime;  // NULL for the builtins.o of this build
+} EmitOptions;
+
+bool emit_parse_kind(const char* name, EmitKind* kind);
+// ".ll", ".bc", ".o" or nothing for executables
+const char* emit_extension(EmitKind kind);
+
+/*
+ * Compile the file of compilation (set up with no output) and write
+ * the module codegen built to path: printed for EMIT_LL, otherwise
+ * emitted in-process through LLVM (no llc), so it needs HELK_LLVM.
+ * Nothing is written for inputs that fail to compile. Errors go to
+ * diagnostics.
+ */
+bool emit_file(Compilation* compilation, const char* path, const EmitOptions* options, FILE* diagnostics);
+
+#endif
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <math.h>
+#include "builtins.h"
 
 double print(double x) {
     printf("%f\n", x);
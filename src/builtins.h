@@ -0,0 +1,11 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+// The runtime every HULK program is linked against; --run hands these
+// to the JIT instead
+double print(double x);
+double prints(char* ptr);
+double max(double a, double b);
+double min(double a, double b);
+
+#endif
@@ -1,66 +1,308 @@
 #include "codegen.h"
+#include "log.h"
+#include "compiler.h"
+#include "arena.h"
+#include "intern.h"
+#include "timer.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <stdarg.h>
+#include <llvm-c/Analysis.h>
 
-static void emit(CodegenContext* ctx, const char* format, ...) {
-    va_list args;
-    va_start(args, format);
-    vfprintf(ctx->output, format, args);
-    va_end(args);
+static LLVMTypeRef double_type(CodegenContext* ctx) {
+    return LLVMDoubleTypeInContext(ctx->llvm);
 }
 
-char* joink_type(ASTNode* node) {
+static LLVMTypeRef string_type(CodegenContext* ctx) {
+    return LLVMPointerType(LLVMInt8TypeInContext(ctx->llvm), 0);
+}
+
+static LLVMTypeRef joink_type(CodegenContext* ctx, ASTNode* node) {
     if (node->type_info.kind == TYPE_STRING) {
-        return "i8*";
+        return string_type(ctx);
     }
     else if (node->type_info.kind == TYPE_DOUBLE) {
-        return "double";
+        return double_type(ctx);
     }
     else if (node->type_info.kind == TYPE_UNKNOWN) {
-        fprintf(stderr, "WARNING - Type of node %d unknown during codegen\n", node->type);
+        LOG_WARNING(LOG_CODEGEN, "Type of node %d unknown during codegen\n", node->type);
         //return "(unkown)";
-        return "double";
+        return double_type(ctx);
     }
     else {
         //return node->type_info.name;
-        return "i8*";
+        return string_type(ctx);
     }
 }
 
 static char* new_temp(CodegenContext* ctx) {
-    char* temp = malloc(16);
+    char* temp = hk_malloc(16);
     sprintf(temp, "%%t%d", ctx->temp_counter++);
     return temp;
 }
 
-static char* new_label(CodegenContext* ctx) {
-    char* temp = malloc(16);
-    sprintf(temp, "l%d", ctx->label_counter++);
-    return temp;
+// the number of a new label (the block is called l<number>)
+static int new_label(CodegenContext* ctx) {
+    return ctx->label_counter++;
 }
 
-static char* to_str_ptr(const char* name) {
-    char* temp = malloc(17);
-    sprintf(temp, "@%s", name);
+static char* new_arg(const char* name) {
+    char* temp = hk_malloc(strlen(name) + 2);
+    sprintf(temp, "%%%s", name);
 
     return temp;
 }
 
-static char* new_arg(const char* name) {
-    char* temp = malloc(17);
-    sprintf(temp, "%%%s", name);
-
+static char* with_suffix(const char* name, const char* suffix) {
+    char* temp = hk_malloc(strlen(name) + strlen(suffix) + 1);
+    sprintf(temp, "%s%s", name, suffix);
     return temp;
 }
 
 char* detach_method(char* cls, char* method) {
-    char* temp = malloc(16 + 16);
+    char* temp = hk_malloc(strlen(cls) + strlen(method) + 2);
     sprintf(temp, "%s_%s", cls, method);
     return temp;
 }
 
+// LLVM names values like their temps, without the sigil
+static const char* llvm_name(const char* temp) {
+    return (temp[0] == '%' || temp[0] == '@') ? temp + 1 : temp;
+}
+
+static size_t hash_name(const char* name) {
+    // FNV-1a
+    size_t hash = 14695981039346656037u;
+    for (; *name; name++) {
+        hash = (hash ^ (unsigned char) *name) * 1099511628211u;
+    }
+    return hash;
+}
+
+// the slot of name, or the empty one it would go to
+static size_t name_map_find(const NameMap* map, const char* name) {
+    size_t mask = map->capacity - 1;
+    size_t i = hash_name(name) & mask;
+    while (map->keys[i] != NULL && strcmp(map->keys[i], name) != 0) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static void* name_map_get(const NameMap* map, const char* name) {
+    if (map->capacity == 0) {
+        return NULL;
+    }
+    size_t i = name_map_find(map, name);
+    return map->keys[i] ? map->values[i] : NULL;
+}
+
+static void name_map_put(NameMap* map, const char* name, void* value) {
+    if (2 * (map->count + 1) > map->capacity) {
+        NameMap grown = {0};
+        grown.capacity = map->capacity ? 2 * map->capacity : 64;
+        grown.keys = hk_calloc(grown.capacity, sizeof(char*));
+        grown.values = hk_calloc(grown.capacity, sizeof(void*));
+        for (size_t i = 0; i < map->capacity; i++) {
+            if (map->keys[i] != NULL) {
+                size_t j = name_map_find(&grown, map->keys[i]);
+                grown.keys[j] = map->keys[i];
+                grown.values[j] = map->values[i];
+                grown.count++;
+            }
+        }
+        hk_free(map->keys);
+        hk_free(map->values);
+        *map = grown;
+    }
+
+    size_t i = name_map_find(map, name);
+    if (map->keys[i] == NULL) {
+        map->keys[i] = name;
+        map->count++;
+    }
+    map->values[i] = value;
+}
+
+// NULL if nothing defined name (yet)
+static LLVMValueRef lookup_value(CodegenContext* ctx, const char* name) {
+    if (name == NULL) {
+        return NULL;
+    }
+    if (name[0] == '@') {
+        return name_map_get(ctx->globals, name);
+    }
+    for (CodegenFunction* function = ctx->function; function != NULL; function = function->parent) {
+        LLVMValueRef value = name_map_get(&function->values, name);
+        if (value != NULL) {
+            return value;
+        }
+    }
+    return NULL;
+}
+
+static LLVMValueRef value_of(CodegenContext* ctx, const char* name) {
+    LLVMValueRef value = lookup_value(ctx, name);
+    if (value == NULL) {
+        if (ctx->function != NULL && ctx->function->dry) {
+            // nobody looks at what a dry run builds
+            return LLVMGetUndef(double_type(ctx));
+        }
+        LOG_ERROR(LOG_CODEGEN, "Use of undefined value '%s'\n", name ? name : "(null)");
+        compile_fail();
+    }
+    return value;
+}
+
+// value_of for the operands that have to be numbers (or objects)
+static LLVMValueRef number_of(CodegenContext* ctx, const char* name) {
+    LLVMValueRef value = value_of(ctx, name);
+    if (LLVMTypeOf(value) != double_type(ctx)) {
+        LOG_ERROR(LOG_CODEGEN, "'%s' is not a number\n", name);
+        compile_fail();
+    }
+    return value;
+}
+
+static LLVMValueRef object_of(CodegenContext* ctx, const char* name) {
+    LLVMValueRef value = value_of(ctx, name);
+    if (LLVMTypeOf(value) != string_type(ctx)) {
+        LOG_ERROR(LOG_CODEGEN, "'%s' is not an object\n", name);
+        compile_fail();
+    }
+    return value;
+}
+
+static void define_value(CodegenContext* ctx, const char* name, LLVMValueRef value) {
+    CodegenFunction* function = ctx->function;
+    if (!function->dry && name_map_get(&function->values, name) != NULL) {
+        LOG_ERROR(LOG_CODEGEN, "Redefinition of '%s'\n", name);
+        compile_fail();
+    }
+    name_map_put(&function->values, name, value);
+
+    // phis that got here first
+    PendingIncoming* pending = name_map_get(&function->pending, name);
+    if (pending != NULL) {
+        for (; pending != NULL; pending = pending->next) {
+            LLVMAddIncoming(pending->phi, &value, &pending->block, 1);
+        }
+        name_map_put(&function->pending, name, NULL);
+    }
+}
+
+// the block of a label, which branches and phis may name before it starts
+static LLVMBasicBlockRef block_for(CodegenContext* ctx, int label) {
+    char name[16];
+    sprintf(name, "l%d", label);
+    LLVMBasicBlockRef block = name_map_get(&ctx->function->blocks, name);
+    if (block == NULL) {
+        block = LLVMAppendBasicBlockInContext(ctx->llvm, ctx->function->function, name);
+        name_map_put(&ctx->function->blocks, hk_strdup(name), block);
+    }
+    return block;
+}
+
+// [name, %l<label>] into phi, once name is defined if codegen is not there yet
+static void add_incoming(CodegenContext* ctx, LLVMValueRef phi, const char* name, int label) {
+    LLVMBasicBlockRef block = block_for(ctx, label);
+    LLVMValueRef value = lookup_value(ctx, name);
+    if (value != NULL) {
+        LLVMAddIncoming(phi, &value, &block, 1);
+        return;
+    }
+    PendingIncoming* pending = hk_malloc(sizeof(PendingIncoming));
+    *pending = (PendingIncoming) {phi, block, name_map_get(&ctx->function->pending, name)};
+    name_map_put(&ctx->function->pending, name, pending);
+}
+
+// continue in the block of label, after everything built so far
+static void start_block(CodegenContext* ctx, int label) {
+    LLVMBasicBlockRef block = block_for(ctx, label);
+    LLVMBasicBlockRef last = LLVMGetLastBasicBlock(ctx->function->function);
+    if (block != last) {
+        LLVMMoveBasicBlockAfter(block, last);
+    }
+    LLVMPositionBuilderAtEnd(ctx->builder, block);
+}
+
+static void finish_function(CodegenContext* ctx) {
+    NameMap* pending = &ctx->function->pending;
+    for (size_t i = 0; i < pending->capacity; i++) {
+        if (pending->values[i] != NULL) {
+            LOG_ERROR(LOG_CODEGEN, "Use of undefined value '%s'\n", pending->keys[i]);
+            compile_fail();
+        }
+    }
+    LLVMClearInsertionPosition(ctx->builder);
+}
+
+// Build into a scratch function that sees the values of the current one
+static void begin_dry_run(CodegenContext* ctx) {
+    CodegenFunction* scratch = hk_calloc(1, sizeof(CodegenFunction));
+    LLVMTypeRef type = LLVMFunctionType(LLVMVoidTypeInContext(ctx->llvm), NULL, 0, false);
+    // unnamed, so it can not clash with the program's functions
+    scratch->function = LLVMAddFunction(ctx->module, "", type);
+    scratch->parent = ctx->function;
+    scratch->dry = true;
+    ctx->function = scratch;
+    LLVMPositionBuilderAtEnd(ctx->builder, LLVMAppendBasicBlockInContext(ctx->llvm, scratch->function, "dry"));
+}
+
+static void end_dry_run(CodegenContext* ctx) {
+    FILE* log = log_stream(LOG_CODEGEN, LOG_LEVEL_DEBUG);
+    if (log != NULL) {
+        char* text = LLVMPrintValueToString(ctx->function->function);
+        fputs(text, log);
+        LLVMDisposeMessage(text);
+    }
+    LLVMDeleteFunction(ctx->function->function);
+    ctx->function = ctx->function->parent;
+}
+
+// %struct.<cls><suffix>, opaque until its type definition is declared
+static LLVMTypeRef struct_type(CodegenContext* ctx, const char* cls, const char* suffix) {
+    char* name = hk_malloc(strlen(cls) + strlen(suffix) + 8);
+    sprintf(name, "struct.%s%s", cls, suffix);
+    LLVMTypeRef type = LLVMGetTypeByName2(ctx->llvm, name);
+    if (type == NULL) {
+        type = LLVMStructCreateNamed(ctx->llvm, name);
+    }
+    hk_free(name);
+    return type;
+}
+
+// ... for code that looks inside it
+static LLVMTypeRef defined_struct_type(CodegenContext* ctx, const char* cls, const char* suffix) {
+    LLVMTypeRef type = cls ? struct_type(ctx, cls, suffix) : NULL;
+    if (type == NULL || LLVMIsOpaqueStruct(type)) {
+        LOG_ERROR(LOG_CODEGEN, "Unknown type '%s'\n", cls ? cls : "(null)");
+        compile_fail();
+    }
+    return type;
+}
+
+// The function called name; calls may come before the definition and declare it
+static LLVMValueRef get_function(CodegenContext* ctx, const char* name, LLVMTypeRef type) {
+    LLVMValueRef function = LLVMGetNamedFunction(ctx->module, name);
+    if (function == NULL) {
+        return LLVMAddFunction(ctx->module, name, type);
+    }
+    if (LLVMGlobalGetValueType(function) != type) {
+        LOG_ERROR(LOG_CODEGEN, "Conflicting types for '%s'\n", name);
+        compile_fail();
+    }
+    return function;
+}
+
+static LLVMValueRef define_function(CodegenContext* ctx, const char* name, LLVMTypeRef type) {
+    LLVMValueRef function = get_function(ctx, name, type);
+    if (LLVMCountBasicBlocks(function) > 0) {
+        LOG_ERROR(LOG_CODEGEN, "Redefinition of '%s'\n", name);
+        compile_fail();
+    }
+    return function;
+}
 
 int get_total_memory(ASTNode** fields, unsigned int field_count) {
     unsigned int total = 0;
@@ -77,19 +319,22 @@ int get_total_memory(ASTNode** fields, unsigned int field_count) {
 static void add_symbol(CodegenContext* ctx, const char* name, const char* temp, ASTNode* node) {
     // Check for existing symbol
     for (size_t i = 0; i < ctx->symbols_size; i++) {
-        if (strcmp(ctx->symbols[i].name, name) == 0) {
-            fprintf(stderr, "Error: Redeclaration of '%s'\n", name);
+        if (ctx->symbols[i].name == name) {
+            LOG_ERROR(LOG_CODEGEN, "Redeclaration of '%s'\n", name);
             return;
         }
     }
     
     // Add new symbol
-    ctx->symbols = realloc(ctx->symbols, (ctx->symbols_size + 1) * sizeof(Symbol));
+    if (ctx->symbols_size >= ctx->symbols_capacity) {
+        ctx->symbols_capacity = ctx->symbols_capacity ? ctx->symbols_capacity * 2 : 16;
+        ctx->symbols = hk_realloc(ctx->symbols, ctx->symbols_capacity * sizeof(Symbol));
+    }
     ctx->symbols[ctx->symbols_size] = (Symbol){
-        .name = strdup(name),
-        .temp = strdup(temp), // this changes after a redefinition
-        .previous_label_name = strdup(temp),
-        .phi = strdup(temp),
+        .name = (char*) name,
+        .temp = hk_strdup(temp), // this changes after a redefinition
+        .previous_label_name = hk_strdup(temp),
+        .phi = hk_strdup(temp),
         .label = ctx->label_counter - 1, // this too
         .previous_label = ctx->label_counter - 1,
         // we use previous_* to identify and restore inconsitencies
@@ -104,13 +349,17 @@ CodegenContext* clone_codegen_context(const CodegenContext* original) {
     }
 
     // Allocate new context
-    CodegenContext* clone = malloc(sizeof(CodegenContext));
+    CodegenContext* clone = hk_malloc(sizeof(CodegenContext));
     if (clone == NULL) {
         return NULL;
     }
 
     // Shallow copy simple members
-    clone->output = original->output;
+    clone->llvm = original->llvm;
+    clone->module = original->module;
+    clone->builder = original->builder;
+    clone->globals = original->globals;
+    clone->function = original->function;
     clone->temp_counter = original->temp_counter;
     clone->label_counter = original->label_counter;
     clone->_last_merge = original->_last_merge;
@@ -119,19 +368,20 @@ CodegenContext* clone_codegen_context(const CodegenContext* original) {
 
     // Deep copy symbols array
     clone->symbols_size = original->symbols_size;
+    clone->symbols_capacity = original->symbols_size;
     if (original->symbols_size > 0) {
-        clone->symbols = malloc(original->symbols_size * sizeof(Symbol));
+        clone->symbols = hk_malloc(original->symbols_size * sizeof(Symbol));
         if (clone->symbols == NULL) {
-            free(clone);
+            hk_free(clone);
             return NULL;
         }
 
-        // Copy each symbol, performing deep copies of strings
+        // Copy each symbol, performing deep copies of strings (names are interned)
         for (size_t i = 0; i < original->symbols_size; i++) {
-            clone->symbols[i].name = original->symbols[i].name ? strdup(original->symbols[i].name) : NULL;
-            clone->symbols[i].temp = original->symbols[i].temp ? strdup(original->symbols[i].temp) : NULL;
-            clone->symbols[i].previous_label_name = original->symbols[i].previous_label_name ? strdup(original->symbols[i].previous_label_name) : NULL;
-            clone->symbols[i].phi = original->symbols[i].phi ? strdup(original->symbols[i].phi) : NULL;
+            clone->symbols[i].name = original->symbols[i].name;
+            clone->symbols[i].temp = original->symbols[i].temp ? hk_strdup(original->symbols[i].temp) : NULL;
+            clone->symbols[i].previous_label_name = original->symbols[i].previous_label_name ? hk_strdup(original->symbols[i].previous_label_name) : NULL;
+            clone->symbols[i].phi = original->symbols[i].phi ? hk_strdup(original->symbols[i].phi) : NULL;
             clone->symbols[i].label = original->symbols[i].label;
             clone->symbols[i].previous_label = original->symbols[i].previous_label;
             clone->symbols[i].node = original->symbols[i].node; // ASTNode doesn't need deep copy
@@ -145,7 +395,7 @@ CodegenContext* clone_codegen_context(const CodegenContext* original) {
 
 static const char* find_symbol(CodegenContext* ctx, const char* name) {
     for (size_t i = 0; i < ctx->symbols_size; i++) {
-        if (strcmp(ctx->symbols[i].name, name) == 0) {
+        if (ctx->symbols[i].name == name) {
             return ctx->symbols[i].temp;
         }
     }
@@ -154,150 +404,102 @@ static const char* find_symbol(CodegenContext* ctx, const char* name) {
 
 Symbol* fetch_symbol(CodegenContext* ctx, const char* name) {
     for (size_t i = 0; i < ctx->symbols_size; i++) {
-        if (strcmp(ctx->symbols[i].name, name) == 0) {
+        if (ctx->symbols[i].name == name) {
             return &ctx->symbols[i];
         }
     }
     return NULL;
 }
 
+// fetch_symbol() for a use: the variable has to have a value by now
+static Symbol* use_symbol(CodegenContext* ctx, const char* name) {
+    Symbol* symbol = fetch_symbol(ctx, name);
+    if (symbol == NULL || symbol->temp == NULL) {
+        LOG_ERROR(LOG_CODEGEN, "Use of undefined variable '%s'\n", name ? name : "(null)");
+        compile_fail();
+    }
+    return symbol;
+}
+
 void fix_labels(CodegenContext* ctx) {
     /*
      * Values modified inside loops do not persist
      */
     for (size_t i = 0; i < ctx->symbols_size; i++) {
         if (ctx->symbols[i].label != ctx->symbols[i].previous_label) {
-            fprintf(stderr, "INFO - Fixing redefinition of %s after exiting loop", ctx->symbols[i].name);
-            ctx->symbols[i].temp = strdup(ctx->symbols[i].previous_label_name);
+            LOG_INFO(LOG_CODEGEN, "Fixing redefinition of %s after exiting loop", ctx->symbols[i].name);
+            ctx->symbols[i].temp = hk_strdup(ctx->symbols[i].previous_label_name);
         }
     }
 }
 
-static char* get_constructor_types(CodegenContext* ctx, ASTNode** args, unsigned int arg_count) {
-    if (arg_count == 0) return strdup("");
-
-    char** temps = malloc(arg_count * sizeof(char*));
-    size_t total_len = 0;
-
-    // Generate code for all arguments first
+static LLVMTypeRef* get_constructor_types(CodegenContext* ctx, ASTNode** args, unsigned int arg_count) {
+    LLVMTypeRef* types = hk_malloc(arg_count * sizeof(LLVMTypeRef));
     for (size_t i = 0; i < arg_count; i++) {
-        total_len += strlen(joink_type(args[i])) + 2;
+        types[i] = joink_type(ctx, args[i]);
     }
-
-    // Build arguments string
-    char* result = malloc(total_len + 1);
-    char* ptr = result;
-
-    for (size_t i = 0; i < arg_count; i++) {
-        int written = sprintf(ptr, "%s%s", joink_type(args[i]), (i < arg_count-1) ? ", " : "");
-        ptr += written;
-    }
-
-    free(temps);
-    return result;
+    return types;
 }
 
-static char* get_call_args(CodegenContext* ctx, ASTNode** args, unsigned int arg_count) {
-    if (arg_count == 0) return strdup("");
-
-    char** temps = malloc(arg_count * sizeof(char*));
-    size_t total_len = 0;
-
-    // Generate code for all arguments first
-    for (size_t i = 0; i < arg_count; i++) {
-        temps[i] = gen_expr(ctx, args[i]);
-        char* type = joink_type(args[i]);
-        total_len += strlen(temps[i]) + strlen(type) + 3;
-    }
-
-    // Build arguments string
-    char* result = malloc(total_len + 1);
-    char* ptr = result;
-
-    for (size_t i = 0; i < arg_count; i++) {
-        int written = sprintf(ptr, "%s %s%s", joink_type(args[i]), temps[i], (i < arg_count-1) ? ", " : "");
-        ptr += written;
-    }
-
-    return result;
+static LLVMTypeRef get_function_type(CodegenContext* ctx, LLVMTypeRef result, ASTNode** args, unsigned int arg_count) {
+    LLVMTypeRef* types = get_constructor_types(ctx, args, arg_count);
+    LLVMTypeRef type = LLVMFunctionType(result, types, arg_count, false);
+    hk_free(types);
+    return type;
 }
 
-static char* get_def_args(char** args, ASTNode** args_definitions, unsigned int arg_count) {
-    if (arg_count == 0) return strdup("");
-
-    char** temps = malloc(arg_count * sizeof(char*));
-    size_t total_len = 0;
+static char** get_call_args(CodegenContext* ctx, ASTNode** args, unsigned int arg_count) {
+    char** temps = hk_malloc(arg_count * sizeof(char*));
 
     // Generate code for all arguments first
     for (size_t i = 0; i < arg_count; i++) {
-        temps[i] = args[i];
-        char* type = joink_type(args_definitions[i]);
-        total_len += strlen(temps[i]) + strlen(type) + 4;
-    }
-
-    // Build arguments string
-    char* result = malloc(total_len + 1);
-    char* ptr = result;
-
-    for (size_t i = 0; i < arg_count; i++) {
-        int written = sprintf(ptr, "%s %s%s%s", joink_type(args_definitions[i]) , "%", temps[i], (i < arg_count-1) ? ", " : "");
-        ptr += written;
+        temps[i] = gen_expr(ctx, args[i]);
     }
-
-    free(temps);
-    return result;
+    return temps;
 }
 
-static char* get_constructor_args(ASTNode** args, unsigned int arg_count) {
-    if (arg_count == 0) return strdup("");
-
-    char** temps = malloc(arg_count * sizeof(char*));
-    size_t total_len = 0;
-
-    // Generate code for all arguments first
-    for (size_t i = 0; i < arg_count; i++) {
-        temps[i] = args[i]->field_def.name;
-        char* type = joink_type(args[i]);
-        total_len += strlen(temps[i]) + strlen(type) + 5;
+// Give %struct.X and %struct.X_vtable their bodies before any code looks inside them
+static void declare_type(CodegenContext* ctx, ASTNode* node) {
+    LLVMTypeRef vtable_type = struct_type(ctx, node->type_decl.name, "_vtable");
+    LLVMTypeRef object_type = struct_type(ctx, node->type_decl.name, "");
+    if (!LLVMIsOpaqueStruct(object_type)) {
+        LOG_ERROR(LOG_CODEGEN, "Redefinition of type '%s'\n", node->type_decl.name);
+        compile_fail();
     }
 
-    // Build arguments string
-    char* result = malloc(total_len + 1);
-    char* ptr = result;
-
-    for (size_t i = 0; i < arg_count; i++) {
-        int written = sprintf(ptr, "%s %s%s%s", joink_type(args[i]), "%", temps[i], (i < arg_count-1) ? ", " : "");
-        ptr += written;
-    }
-
-    free(temps);
-    return result;
-}
-
-// Generate vtable structure
-void generate_vtable(CodegenContext* ctx, ASTNode* node) {
-    // Define vtable structure type
-    emit(ctx, "%%struct.%s_vtable = type {\n  ", node->type_decl.name);
-    for (size_t i = 0; i < node->type_decl.method_count; i++) {
-        if (i > 0) emit(ctx, ",\n  ");
+    // a function pointer per method
+    unsigned int method_count = node->type_decl.method_count;
+    LLVMTypeRef* methods = hk_malloc(method_count * sizeof(LLVMTypeRef));
+    for (size_t i = 0; i < method_count; i++) {
         ASTNode* method = node->type_decl.methods[i];
-        emit(
+        LLVMTypeRef type = get_function_type(
             ctx,
-            "%s (%s)*",
-            joink_type(method),
-            get_constructor_types(
-                ctx,
-                method->function_def.args_definitions,
-                method->function_def.arg_count
-            )
+            joink_type(ctx, method),
+            method->function_def.args_definitions,
+            method->function_def.arg_count
         );
+        methods[i] = LLVMPointerType(type, 0);
+    }
+    LLVMStructSetBody(vtable_type, methods, method_count, false);
+
+    // the vtable, then the fields
+    unsigned int field_count = node->type_decl.field_count;
+    LLVMTypeRef* fields = hk_malloc((field_count + 1) * sizeof(LLVMTypeRef));
+    fields[0] = LLVMPointerType(vtable_type, 0);
+    for (size_t i = 0; i < field_count; i++) {
+        fields[i + 1] = joink_type(ctx, node->type_decl.fields[i]);
     }
-    emit(ctx, "\n}\n");
+    LLVMStructSetBody(object_type, fields, field_count + 1, false);
 
-    // Create global vtable instance
-    emit(ctx, "@%s_vtable = global %%struct.%s_vtable {\n  ", node->type_decl.name, node->type_decl.name);
+    hk_free(methods);
+    hk_free(fields);
+}
+
+// Generate the global vtable instance
+LLVMValueRef generate_vtable(CodegenContext* ctx, ASTNode* node) {
+    LLVMTypeRef vtable_type = struct_type(ctx, node->type_decl.name, "_vtable");
+    LLVMValueRef* methods = hk_malloc(node->type_decl.method_count * sizeof(LLVMValueRef));
     for (size_t i = 0; i < node->type_decl.method_count; i++) {
-        if (i > 0) emit(ctx, ",\n  ");
         char* mangled_name;
         if (node->type_decl.methods[i]->function_def.args_definitions[0]->type_info.kind != node->type_info.kind) {
             mangled_name = node->type_decl.methods[i]->function_def.name;
@@ -306,20 +508,63 @@ void generate_vtable(CodegenContext* ctx, ASTNode* node) {
             mangled_name = detach_method(node->type_decl.name,
                 node->type_decl.methods[i]->function_def.name);
         }
-        ASTNode* method = node->type_decl.methods[i];
-        emit(
-            ctx,
-            "%s (%s)*",
-            joink_type(method),
-            get_constructor_types(
-                ctx,
-                method->function_def.args_definitions,
-                method->function_def.arg_count
-            )
-        );
-        emit(ctx, " @%s", mangled_name);
+        LLVMTypeRef type = LLVMGetElementType(LLVMStructGetTypeAtIndex(vtable_type, i));
+        methods[i] = get_function(ctx, mangled_name, type);
     }
-    emit(ctx, "\n}\n");
+
+    char* name = with_suffix(node->type_decl.name, "_vtable");
+    LLVMValueRef vtable = LLVMAddGlobal(ctx->module, vtable_type, name);
+    LLVMSetInitializer(vtable, LLVMConstNamedStruct(vtable_type, methods, node->type_decl.method_count));
+    hk_free(name);
+    hk_free(methods);
+    return vtable;
+}
+
+void generate_constructor(CodegenContext* ctx, ASTNode* node, LLVMValueRef vtable) {
+    LLVMTypeRef object_type = struct_type(ctx, node->type_decl.name, "");
+    unsigned int field_count = node->type_decl.field_count;
+    char* name = with_suffix(node->type_decl.name, "_constructor");
+    LLVMValueRef constructor = define_function(
+        ctx,
+        name,
+        get_function_type(ctx, string_type(ctx), node->type_decl.fields, field_count)
+    );
+    LLVMPositionBuilderAtEnd(ctx->builder, LLVMAppendBasicBlockInContext(ctx->llvm, constructor, ""));
+
+    LLVMValueRef malloc_function = LLVMGetNamedFunction(ctx->module, "malloc");
+    LLVMValueRef size = LLVMConstInt(
+        LLVMInt32TypeInContext(ctx->llvm),
+        get_total_memory(node->type_decl.fields, field_count),
+        false
+    );
+    LLVMValueRef heap_ptr = LLVMBuildCall2(
+        ctx->builder,
+        LLVMGlobalGetValueType(malloc_function),
+        malloc_function,
+        &size,
+        1,
+        "heap_ptr"
+    );
+    LLVMValueRef obj_ptr = LLVMBuildBitCast(ctx->builder, heap_ptr, LLVMPointerType(object_type, 0), "obj_ptr");
+
+    // Set vtable pointer
+    LLVMValueRef vtable_ptr = LLVMBuildStructGEP2(ctx->builder, object_type, obj_ptr, 0, "vtable_ptr");
+    LLVMBuildStore(ctx->builder, vtable, vtable_ptr);
+
+    for (size_t i = 0; i < field_count; i++) {
+        size_t field_index = i + 1; // +1 for vtable pointer
+        char* field = node->type_decl.fields[i]->field_def.name;
+        LLVMValueRef value = LLVMGetParam(constructor, i);
+        LLVMSetValueName2(value, field, strlen(field));
+
+        char* field_ptr_name = with_suffix(field, "_ptr");
+        LLVMValueRef field_ptr = LLVMBuildStructGEP2(ctx->builder, object_type, obj_ptr, field_index, field_ptr_name);
+        LLVMBuildStore(ctx->builder, value, field_ptr);
+        hk_free(field_ptr_name);
+    }
+    LLVMBuildRet(ctx->builder, heap_ptr);
+    LLVMClearInsertionPosition(ctx->builder);
+    hk_free(name);
 }
 
 void gen_method_call(CodegenContext* ctx, ASTNode* node) {
@@ -328,8 +573,8 @@ void gen_method_call(CodegenContext* ctx, ASTNode* node) {
      * should generate a static call or a virtual call using
      * vtable lookups
      */
-    emit(ctx, "\n  ; Start virtual method call\n");
-    char* temp = new_temp(ctx);
+    LOG_DEBUG(LOG_CODEGEN, "Start virtual method call\n");
+    new_temp(ctx);
 
     // Get object pointer from 'self'
     ASTNode* instance = node->method_call.cls;
@@ -340,85 +585,82 @@ void gen_method_call(CodegenContext* ctx, ASTNode* node) {
     // Cast vtable pointer
     char* vtable_ptr_temp = new_temp(ctx);
     char* cls = instance->type_info.cls;
-    emit(ctx, "  %s = bitcast i8* %s to %%struct.%s*\n",
-         vtable_ptr_temp, obj_temp, cls);
+    LLVMTypeRef object_type = defined_struct_type(ctx, cls, "");
+    LLVMTypeRef vtable_type = defined_struct_type(ctx, cls, "_vtable");
+    LLVMValueRef vtable_ptr = LLVMBuildBitCast(
+        ctx->builder,
+        object_of(ctx, obj_temp),
+        LLVMPointerType(object_type, 0),
+        llvm_name(vtable_ptr_temp)
+    );
 
     // Load vtable
     char* vtable_temp = new_temp(ctx);
-    emit(ctx, "  %s = getelementptr %%struct.%s, %%struct.%s* %s, i32 0, i32 0\n",
-         vtable_temp, cls, cls, vtable_ptr_temp);
-    emit(ctx, "  %s_vtable = load %%struct.%s_vtable*, %%struct.%s_vtable** %s\n",
-         vtable_temp, cls, cls, vtable_temp);
+    LLVMValueRef vtable_slot = LLVMBuildStructGEP2(ctx->builder, object_type, vtable_ptr, 0, llvm_name(vtable_temp));
+    char* vtable_name = with_suffix(llvm_name(vtable_temp), "_vtable");
+    LLVMValueRef vtable = LLVMBuildLoad2(ctx->builder, LLVMPointerType(vtable_type, 0), vtable_slot, vtable_name);
 
     // Get method pointer
-    int method_index = node->method_call.pos;
+    unsigned int method_index = node->method_call.pos;
+    if (method_index >= LLVMCountStructElementTypes(vtable_type)) {
+        LOG_ERROR(LOG_CODEGEN, "%s has no method %u\n", cls, method_index);
+        compile_fail();
+    }
     char* method_ptr_temp = new_temp(ctx);
-    emit(ctx, "  %s = getelementptr %%struct.%s_vtable, %%struct.%s_vtable* %s_vtable, i32 0, i32 %d\n",
-         method_ptr_temp, cls, cls, vtable_temp, method_index);
+    LLVMValueRef method_ptr = LLVMBuildStructGEP2(
+        ctx->builder,
+        vtable_type,
+        vtable,
+        method_index,
+        llvm_name(method_ptr_temp)
+    );
 
     // Load function pointer
     char* func_ptr_temp = new_temp(ctx);
-    emit(ctx, "  %s = load ", func_ptr_temp);
-    emit(
-        ctx,
-        "%s (%s)*",
-        joink_type(node),
-        get_constructor_types(
-            ctx,
-            node->function_def.args_definitions,
-            node->function_def.arg_count
-        )
-    );
-    emit(ctx, ", ");
-    emit(
-        ctx,
-        "%s (%s)**",
-        joink_type(node),
-        get_constructor_types(
-            ctx,
-            node->function_def.args_definitions,
-            node->function_def.arg_count
-        )
+    LLVMValueRef func_ptr = LLVMBuildLoad2(
+        ctx->builder,
+        LLVMStructGetTypeAtIndex(vtable_type, method_index),
+        method_ptr,
+        llvm_name(func_ptr_temp)
     );
-    emit(ctx, " %s\n", method_ptr_temp);
+    define_value(ctx, func_ptr_temp, func_ptr);
 
     node->method_call.method = func_ptr_temp;
-    emit(ctx, "  ; End virtual method call\n\n");
+    LOG_DEBUG(LOG_CODEGEN, "End virtual method call\n");
+    hk_free(vtable_name);
     return;
 }
 
 
 static char* gen_while_loop(CodegenContext* ctx, ASTNode* node) {
-    char* body_label = new_label(ctx);
-    int body_cnt = ctx->label_counter - 1;
+    int body_cnt = new_label(ctx);
 
     // Initial unconditional branch to condition
-    emit(ctx, "  ; While body\n", body_label);
-    emit(ctx, "  br label %%%s\n", body_label);
-
+    LLVMBuildBr(ctx->builder, block_for(ctx, body_cnt));
 
     // Body block
-    emit(ctx, "%s:\n", body_label);
+    start_block(ctx, body_cnt);
 
     CodegenContext* new_ctx = clone_codegen_context(ctx);
     int wtemp = ctx->_last_merge_while;
-    fprintf(stderr, "\n--------START-------\n");
-    new_ctx->output = stderr;
+    LOG_DEBUG(LOG_CODEGEN, "\n--------START-------\n");
+    begin_dry_run(new_ctx);
     gen_expr(new_ctx, node->while_loop.body);
+    end_dry_run(new_ctx);
+    LLVMPositionBuilderAtEnd(ctx->builder, block_for(ctx, body_cnt));
 
-    fprintf(stderr, "\n--------END---------\n");
-    fprintf(stderr, "----> merge_while: %d %d\n", ctx->_last_merge_while, new_ctx->_last_merge_while);
+    LOG_DEBUG(LOG_CODEGEN, "\n--------END---------\n");
+    LOG_DEBUG(LOG_CODEGEN, "----> merge_while: %d %d\n", ctx->_last_merge_while, new_ctx->_last_merge_while);
     if (wtemp != new_ctx->_last_merge_while) {
         ctx->_last_merge_while = new_ctx->_last_merge_while;
-        exit(1);
+        compile_fail();
     }
     else {
         ctx->_last_merge_while = new_ctx->label_counter;
     }
-    fprintf(stderr, "----> merge_while: %d %d\n", ctx->_last_merge_while, new_ctx->_last_merge_while);
+    LOG_DEBUG(LOG_CODEGEN, "----> merge_while: %d %d\n", ctx->_last_merge_while, new_ctx->_last_merge_while);
 
     // Shallow copy simple members
-    //ctx->output = new_ctx->output;
     //ctx->temp_counter = new_ctx->temp_counter;
     //ctx->label_counter = new_ctx->label_counter;
     //ctx->_last_merge = new_ctx->_last_merge;
@@ -428,26 +670,31 @@ static char* gen_while_loop(CodegenContext* ctx, ASTNode* node) {
     // set current label
     ctx->current_label = body_cnt;
     gen_expr(ctx, node->while_loop.body);
-    //free(body_temp);
+    //hk_free(body_temp);
 
     // Condition block
     char* cond_temp = gen_expr(ctx, node->while_loop.cond);
-    char* end_label = new_label(ctx);
-    int end_cnt = ctx->label_counter - 1;
-    emit(ctx, "  %%while_cond%d = fcmp one double %s, 0.000000e+00\n", ctx->temp_counter, cond_temp);
-    emit(ctx, "  br i1 %%while_cond%d, label %%%s, label %%%s\n", ctx->temp_counter,
-        body_label, end_label);
-    //free(cond_temp);
+    int end_cnt = new_label(ctx);
+    char cond_name[32];
+    sprintf(cond_name, "while_cond%d", ctx->temp_counter);
+    LLVMValueRef cond = LLVMBuildFCmp(
+        ctx->builder,
+        LLVMRealONE,
+        number_of(ctx, cond_temp),
+        LLVMConstReal(double_type(ctx), 0.0),
+        cond_name
+    );
+    LLVMBuildCondBr(ctx->builder, cond, block_for(ctx, body_cnt), block_for(ctx, end_cnt));
+    //hk_free(cond_temp);
 
     // End block
-    emit(ctx, "  ; End while\n", end_label);
-    emit(ctx, "%s:\n", end_label);
+    start_block(ctx, end_cnt);
     // set current label
     ctx->current_label = end_cnt;
 
+    // Dummy value
     char* result = new_temp(ctx);
-    emit(ctx, "  ; Dummy value\n", result);
-    emit(ctx, "  %s = fadd double 0.000000e+00, 0.000000e+00\n", result);
+    define_value(ctx, result, LLVMConstReal(double_type(ctx), 0.0));
 
 
 
@@ -467,25 +714,28 @@ static char* gen_conditional(CodegenContext* ctx, ASTNode* node) {
 
     char* hyp_temp = gen_expr(ctx, node->conditional.hypothesis);
 
-    char* thesis_label = new_label(ctx);
-    int thesis_cnt = ctx->label_counter - 1;
-
-    char* anti_label = new_label(ctx);
-    int anti_cnt = ctx->label_counter - 1;
+    int thesis_cnt = new_label(ctx);
+    int anti_cnt = new_label(ctx);
 
     // Compare condition to 0 (false)
-    emit(ctx, "  %%cond%d = fcmp one double %s, 0.000000e+00\n", ctx->temp_counter++, hyp_temp);
-    emit(ctx, "  br i1 %%cond%d, label %%%s, label %%%s\n\n",
-        ctx->temp_counter-1, thesis_label, anti_label);
+    char cond_name[32];
+    sprintf(cond_name, "cond%d", ctx->temp_counter++);
+    LLVMValueRef cond = LLVMBuildFCmp(
+        ctx->builder,
+        LLVMRealONE,
+        number_of(ctx, hyp_temp),
+        LLVMConstReal(double_type(ctx), 0.0),
+        cond_name
+    );
+    LLVMBuildCondBr(ctx->builder, cond, block_for(ctx, thesis_cnt), block_for(ctx, anti_cnt));
 
     // Thesis block
-    emit(ctx, "%s:\n", thesis_label);
+    start_block(ctx, thesis_cnt);
     // update current label
     ctx->current_label = thesis_cnt;
     char* thesis_temp = gen_expr(ctx, node->conditional.thesis);
-    char* merge_label = new_label(ctx);
-    int merge_cnt = ctx->label_counter - 1;
-    emit(ctx, "  br label %%%s\n\n", merge_label);
+    int merge_cnt = new_label(ctx);
+    LLVMBuildBr(ctx->builder, block_for(ctx, merge_cnt));
 
     // the merge point might have changed so we have to check
     if (_last_merge != ctx->_last_merge) {
@@ -494,11 +744,11 @@ static char* gen_conditional(CodegenContext* ctx, ASTNode* node) {
     }
 
     // Antithesis block
-    emit(ctx, "%s:\n", anti_label);
+    start_block(ctx, anti_cnt);
     // update current label
     ctx->current_label = anti_cnt;
     char* anti_temp = gen_expr(ctx, node->conditional.antithesis);
-    emit(ctx, "  br label %%%s\n\n", merge_label);
+    LLVMBuildBr(ctx->builder, block_for(ctx, merge_cnt));
 
     // Verify if we generated a new merge point inside the antithesis
     if (_last_merge != ctx->_last_merge) {
@@ -506,17 +756,20 @@ static char* gen_conditional(CodegenContext* ctx, ASTNode* node) {
         _last_merge = ctx->_last_merge;
     }
 
-    emit(ctx, "  ; Conditional merge point\n");
-    emit(ctx, "%s:\n", merge_label);
+    // Conditional merge point
+    start_block(ctx, merge_cnt);
     // update current label
     ctx->current_label = merge_cnt;
     char* result_temp = new_temp(ctx);
-    emit(ctx, "  %s = phi %s [ %s, %%l%d ], [ %s, %%l%d ]\n",
-        result_temp, joink_type(node), thesis_temp, thesis_cnt, anti_temp, anti_cnt);
+    LLVMValueRef phi = LLVMBuildPhi(ctx->builder, joink_type(ctx, node), llvm_name(result_temp));
+    LLVMValueRef values[] = {value_of(ctx, thesis_temp), value_of(ctx, anti_temp)};
+    LLVMBasicBlockRef blocks[] = {block_for(ctx, thesis_cnt), block_for(ctx, anti_cnt)};
+    LLVMAddIncoming(phi, values, blocks, 2);
+    define_value(ctx, result_temp, phi);
 
-    free(hyp_temp);
-    free(thesis_temp);
-    free(anti_temp);
+    hk_free(hyp_temp);
+    hk_free(thesis_temp);
+    hk_free(anti_temp);
 
     ctx->_last_merge = merge_cnt;
     ctx->_last_merge_while = merge_cnt;
@@ -533,14 +786,15 @@ static char* gen_expr(CodegenContext* ctx, ASTNode* node) {
     char* temp;
 
     switch (node->type) {
-        case AST_NUMBER:
+        case AST_NUMBER: {
             temp = new_temp(ctx);
-            emit(ctx, "  %s = fadd double 0.000000e+00, %f\n", temp, node->number);
+            define_value(ctx, temp, LLVMConstReal(double_type(ctx), node->number));
             return temp;
+        }
         case AST_STRING: {
             const char* var_temp = find_symbol(ctx, node->string);
             if (!var_temp) {
-                fprintf(stderr, "ERROR - Undefined string '%s'\n", node->string);
+                LOG_ERROR(LOG_CODEGEN, "Undefined string '%s'\n", node->string);
                 return NULL;
             }
 
@@ -550,30 +804,34 @@ static char* gen_expr(CodegenContext* ctx, ASTNode* node) {
         case AST_BINARY_OP: {
             char* left = gen_expr(ctx, node->binary_op.left);
             char* right = gen_expr(ctx, node->binary_op.right);
-            const char* op = NULL;
+            LLVMOpcode op = LLVMFAdd;
             
             switch (node->binary_op.op) {
-                case OP_ADD: op = "fadd"; break;
-                case OP_SUB: op = "fsub"; break;
-                case OP_MUL: op = "fmul"; break;
-                case OP_DIV: op = "fdiv"; break;
-                case OP_MOD: op = "frem"; break;
+                case OP_ADD: op = LLVMFAdd; break;
+                case OP_SUB: op = LLVMFSub; break;
+                case OP_MUL: op = LLVMFMul; break;
+                case OP_DIV: op = LLVMFDiv; break;
+                case OP_MOD: op = LLVMFRem; break;
             }
             
 
             temp = new_temp(ctx);
-            emit(ctx, "  %s = %s double %s, %s\n", temp, op, left, right);
+            LLVMValueRef value = LLVMBuildBinOp(
+                ctx->builder,
+                op,
+                number_of(ctx, left),
+                number_of(ctx, right),
+                llvm_name(temp)
+            );
+            define_value(ctx, temp, value);
  
-            //free(left);  // variable (const str)!
-            //free(right);
+            //hk_free(left);  // variable (const str)!
+            //hk_free(right);
             return temp;
         }            
         case AST_VARIABLE: {
-            Symbol* symbol = fetch_symbol(ctx, node->variable.name);
-            emit(ctx, "  ; Load variable %s (%s)\n", node->variable.name, symbol->temp);
-            if (symbol->temp == NULL) {
-                exit(1);
-            }
+            Symbol* symbol = use_symbol(ctx, node->variable.name);
+            LOG_DEBUG(LOG_CODEGEN, "Load variable %s (%s)\n", node->variable.name, symbol->temp);
             return symbol->temp;
         }
         case AST_VARIABLE_DEF: {
@@ -582,23 +840,19 @@ static char* gen_expr(CodegenContext* ctx, ASTNode* node) {
 
             if (symbol) {
                 if (symbol->label == ctx->label_counter - 1) {
-                    fprintf(
-                        stderr,
-                        "WARNING - Dangerous redefinition detected (%s). The variable now points to a new temp var.\n",
+                    LOG_WARNING(LOG_CODEGEN, "Dangerous redefinition detected (%s). The variable now points to a new temp var.\n",
                         symbol->name
                     );
 
                     symbol->temp = gen_expr(ctx, node->variable_def.body);
                     /// XXX reassign
-                    //emit(ctx, "  %s = fadd double %s, 0.000000e+00  ; Load variable\n", temp, symbol->temp);
                     //return symbol->temp;
                     return symbol->name;
                 }
                 t4 = gen_expr(ctx, node->variable_def.body);
 
-                // no-op to make t3 = t4 since we don't know how many operations we will make
-                // XXX double
-                emit(ctx, "  %s = fadd double %s, 0.000000e+00  ; Load variable\n", symbol->phi, t4);
+                // t3 = t4, the value the phi gets when the loop comes around
+                define_value(ctx, symbol->phi, value_of(ctx, t4));
 
                 symbol->temp = symbol->phi;
                 // do not free anything here
@@ -606,10 +860,7 @@ static char* gen_expr(CodegenContext* ctx, ASTNode* node) {
             else {
                 t4 = gen_expr(ctx, node->variable_def.body);
                 add_symbol(ctx, node->variable_def.name, t4, node);
-                emit(
-                    ctx, "  ; Variable assignment: %s = %s\n", 
-                    node->variable_def.name, t4
-                );
+                LOG_DEBUG(LOG_CODEGEN, "Variable assignment: %s = %s\n", node->variable_def.name, t4);
             }
             return t4;
         }
@@ -619,17 +870,18 @@ static char* gen_expr(CodegenContext* ctx, ASTNode* node) {
             char* temp = new_temp(ctx);
 
 
-            size_t arg_count;
-            char* call_args;
+            unsigned int arg_count;
+            ASTNode** args;
             if (node->type == AST_FUNCTION_CALL) {
                 arg_count = node->function_call.arg_count;
-                call_args = get_call_args(ctx, node->function_call.args, arg_count);
+                args = node->function_call.args;
             }
             else {
                 arg_count = node->method_call.arg_count;
-                call_args = get_call_args(ctx, node->method_call.args, arg_count);
+                args = node->method_call.args;
             }
-            char* type = joink_type(node);
+            char** call_args = get_call_args(ctx, args, arg_count);
+            LLVMTypeRef type = joink_type(ctx, node);
 
             if (node->type == AST_METHOD_CALL) {
                 // pass self to method
@@ -646,13 +898,28 @@ static char* gen_expr(CodegenContext* ctx, ASTNode* node) {
             else {
                 name = node->method_call.method;
             }
-            emit(ctx, "  %s = call %s %s%s(", temp, type, ((char) name[0] != '%') ? "@" : "", name);
-            if (arg_count > 0) {
-                emit(ctx, "%s", call_args);
+
+            LLVMValueRef function;
+            LLVMTypeRef function_type;
+            if (name[0] == '%') {
+                // a function pointer out of the vtable
+                function = value_of(ctx, name);
+                function_type = LLVMGetElementType(LLVMTypeOf(function));
+            }
+            else {
+                function_type = get_function_type(ctx, type, args, arg_count);
+                function = get_function(ctx, name, function_type);
+            }
+
+            LLVMValueRef* values = hk_malloc(arg_count * sizeof(LLVMValueRef));
+            for (size_t i = 0; i < arg_count; i++) {
+                values[i] = value_of(ctx, call_args[i]);
             }
-            emit(ctx, ")\n");
+            LLVMValueRef call = LLVMBuildCall2(ctx->builder, function_type, function, values, arg_count, llvm_name(temp));
+            define_value(ctx, temp, call);
             
-            free(call_args);
+            hk_free(values);
+            hk_free(call_args);
 
             return temp;
         }
@@ -664,47 +931,40 @@ static char* gen_expr(CodegenContext* ctx, ASTNode* node) {
         }
         case AST_FIELD_ACCESS: {
             char* temp = new_temp(ctx);
-            Symbol* symbol = fetch_symbol(ctx, node->field_access.cls);
-
-            emit(
-                ctx,
-                "  %s_ref = bitcast i8* %s to %%struct.%s*\n",
-                temp,
-                symbol->temp,
-                symbol->node->type_info.cls
+            Symbol* symbol = use_symbol(ctx, node->field_access.cls);
+            LLVMTypeRef object_type = defined_struct_type(ctx, symbol->node->type_info.cls, "");
+
+            char* ref_name = with_suffix(llvm_name(temp), "_ref");
+            LLVMValueRef ref = LLVMBuildBitCast(
+                ctx->builder,
+                object_of(ctx, symbol->temp),
+                LLVMPointerType(object_type, 0),
+                ref_name
             );
 
-
-            emit(
-                ctx,
-                "  %s_ptr = getelementptr %%struct.%s, %s %s_ref, i32 0, i32 %d\n",
-                temp,
-                symbol->node->type_info.cls,
-                symbol->node->type_info.name,
-                temp,
-                node->field_access.pos + 1 // vtable
-            );
-            emit(
-                ctx,
-                "  %s = load %s, %s* %s_ptr\n",
-                temp,
-                joink_type(node),
-                joink_type(node),
-                temp
-            );
-            fprintf(stderr, "node_type=%zu; field_type=%zu pos=%d\n", symbol->node->type_info.kind, node->type_info.kind, node->field_access.pos);
+            unsigned int field_index = node->field_access.pos + 1; // vtable
+            if (field_index >= LLVMCountStructElementTypes(object_type)
+                || LLVMStructGetTypeAtIndex(object_type, field_index) != joink_type(ctx, node)) {
+                LOG_ERROR(LOG_CODEGEN, "%s has no field %s of that type\n", symbol->node->type_info.cls, node->field_access.field);
+                compile_fail();
+            }
+            // field reassignments store through temp_ptr
+            char* ptr_temp = with_suffix(temp, "_ptr");
+            LLVMValueRef ptr = LLVMBuildStructGEP2(ctx->builder, object_type, ref, field_index, llvm_name(ptr_temp));
+            define_value(ctx, ptr_temp, ptr);
+            define_value(ctx, temp, LLVMBuildLoad2(ctx->builder, joink_type(ctx, node), ptr, llvm_name(temp)));
+            LOG_DEBUG(LOG_CODEGEN, "node_type=%zu; field_type=%zu pos=%d\n", symbol->node->type_info.kind, node->type_info.kind, node->field_access.pos);
+            hk_free(ref_name);
             return temp;
         }
         case AST_FIELD_REASSIGN: {
-            fprintf(stderr, "Reassigning field \n");
+            LOG_DEBUG(LOG_CODEGEN, "Reassigning field \n");
             char* temp = gen_expr(ctx, node->field_reassign.field_access);
-            emit(
-                ctx,
-                "  store %s %%%s, %s* %s_ptr\n",
-                joink_type(node->field_reassign.field_access),
-                node->field_reassign.value,
-                joink_type(node->field_reassign.field_access),
-                temp
+            char* ptr_temp = with_suffix(temp, "_ptr");
+            LLVMBuildStore(
+                ctx->builder,
+                value_of(ctx, new_arg(node->field_reassign.value)),
+                value_of(ctx, ptr_temp)
             );
             return temp;
         }
@@ -713,7 +973,6 @@ static char* gen_expr(CodegenContext* ctx, ASTNode* node) {
             CodegenContext* new_ctx = clone_codegen_context(ctx);
             char* temp = codegen_expr_block(new_ctx, node);
             // Shallow copy simple members
-            ctx->output = new_ctx->output;
             ctx->temp_counter = new_ctx->temp_counter;
             ctx->label_counter = new_ctx->label_counter;
             ctx->_last_merge = new_ctx->_last_merge;
@@ -722,7 +981,7 @@ static char* gen_expr(CodegenContext* ctx, ASTNode* node) {
             //return codegen_expr_block(ctx, node);
         }
         default: {
-            fprintf(stderr, "Error: Failed to parse %d because it is not an expression! \n", node->type);
+            LOG_ERROR(LOG_CODEGEN, "Failed to parse %d because it is not an expression! \n", node->type);
             return NULL;
         }
     }
@@ -746,17 +1005,17 @@ void gen_redefs(CodegenContext* ctx, ASTNode* node) {
             // So we simply rename the variable.
 
             Symbol* symbol = fetch_symbol(ctx, node->variable_def.name);
-            char* type;
+            LLVMTypeRef type;
 
             if (node->type_info.kind == TYPE_STRING) {
-                type = "i8*";
+                type = string_type(ctx);
             }
             else {
-                type = "double";
+                type = double_type(ctx);
             }
 
             if (symbol) {
-                fprintf(stderr, "INFO - Redefinition detected: %s\n", node->variable_def.name);
+                LOG_INFO(LOG_CODEGEN, "Redefinition detected: %s\n", node->variable_def.name);
                 // https://www.cs.utexas.edu/~pingali/CS380C/2010/papers/ssaCytron.pdf
                 //
                 // I notice that the value was already defined
@@ -773,14 +1032,10 @@ void gen_redefs(CodegenContext* ctx, ASTNode* node) {
                 // If we didn't define a new label
                 // Then this becomes a no-op
                 if (symbol->label == ctx->label_counter - 1) {
-                    fprintf(stderr, "WARNING - Dangerous redefinition detected. No operation was made\n");
+                    LOG_WARNING(LOG_CODEGEN, "Dangerous redefinition detected. No operation was made\n");
                     return;
                 }
                 // different labels
-                emit(
-                    ctx, "  ; Variable redefinition: %s\n", 
-                    node->variable_def.name
-                );
 
                 char* t1 = symbol->temp;
                 char* t2 = new_temp(ctx);
@@ -794,12 +1049,11 @@ void gen_redefs(CodegenContext* ctx, ASTNode* node) {
                 else {
                     end = ctx->label_counter - 1;
                 }
-                emit(
-                    ctx,
-                    "  %s = phi %s [%s, %%l%d], [%s, %%l%d]\n",
-                    //t2, type, t1, lbl, t3, ctx->label_counter - 1
-                    t2, type, t1, lbl, t3, end
-                );
+                // %t3 is only defined further down the body
+                LLVMValueRef phi = LLVMBuildPhi(ctx->builder, type, llvm_name(t2));
+                add_incoming(ctx, phi, t1, lbl);
+                add_incoming(ctx, phi, t3, end);
+                define_value(ctx, t2, phi);
 
                 // probably uses the variable (or another variable, recall the gcd algorithm)
                 // Whenever "a" is searched in the symbol table, it will appear as t2
@@ -840,125 +1094,69 @@ void codegen_stmt(CodegenContext* ctx, ASTNode* node) {
     if ((node->type == AST_FUNCTION_DEF) || (node->type == AST_METHOD_DEF)) {
         int enabled = 0;
         if (!node->function_def.called && enabled) {
-            fprintf(stderr, "WARNING - %s function was never called so it won't be generated\n", node->function_def.name);
+            LOG_WARNING(LOG_CODEGEN, "%s function was never called so it won't be generated\n", node->function_def.name);
             return;
         }
         // should ONLY contain functions after sem_anal
+        timer_begin_span(node->function_def.name);
 
         CodegenContext* fun_ctx = clone_codegen_context(ctx);
 
-        char* type = joink_type(node);
-
-        char* entry_label = new_label(fun_ctx);
-        int entry_cnt = fun_ctx->label_counter - 1;
+        bool is_main = strcmp(node->function_def.name, "main") == 0;
         unsigned int arg_count = node->function_def.arg_count;
+        LLVMTypeRef type;
+        // special case for fun main
+        if (is_main) {
+            type = LLVMFunctionType(LLVMInt32TypeInContext(ctx->llvm), NULL, 0, false);
+        }
+        else {
+            type = get_function_type(ctx, joink_type(ctx, node), node->function_def.args_definitions, arg_count);
+        }
+        fun_ctx->function = hk_calloc(1, sizeof(CodegenFunction));
+        fun_ctx->function->function = define_function(ctx, node->function_def.name, type);
+
+        int entry_cnt = new_label(fun_ctx);
 
-        for (unsigned int i = 0; i < arg_count; i++) {
+        for (unsigned int i = 0; i < arg_count && !is_main; i++) {
+            char* arg = new_arg(node->function_def.args[i]);
             add_symbol(
                 fun_ctx,
                 node->function_def.args[i],
-                new_arg(
-                    node->function_def.args[i]
-                ),
+                arg,
                 node->function_def.args_definitions[i]
             );
+            LLVMValueRef value = LLVMGetParam(fun_ctx->function->function, i);
+            LLVMSetValueName2(value, llvm_name(arg), strlen(llvm_name(arg)));
+            define_value(fun_ctx, arg, value);
         }
 
-        char* def_args = get_def_args(
-            node->function_def.args,
-            node->function_def.args_definitions,
-            arg_count
-        );
-
-        // special case for fun main
-        if (strcmp(node->function_def.name, "main") == 0) {
-            emit(fun_ctx, "\ndefine i32 @main() {\n", type, node->function_def.name, def_args);
-        }
-        else if (arg_count > 0) {
-            emit(fun_ctx, "\ndefine %s @%s(%s) {\n", type, node->function_def.name, def_args);
-        }
-        else {
-            emit(fun_ctx, "\ndefine %s @%s() {\n", type, node->function_def.name);
-        }
-        emit(fun_ctx, "%s:\n", entry_label);
+        start_block(fun_ctx, entry_cnt);
         fun_ctx->current_label = entry_cnt;
 
         char* result = gen_expr(fun_ctx, node->function_def.body);
 
 
-        if (strcmp(node->function_def.name, "main") == 0) {
-            emit(fun_ctx, "  ret i32 0\n", type, result);
-            free(result);
+        if (is_main) {
+            LLVMBuildRet(ctx->builder, LLVMConstInt(LLVMInt32TypeInContext(ctx->llvm), 0, false));
+            hk_free(result);
         }
         else if (result) {
-            emit(fun_ctx, "  ret %s %s\n", type, result);
-            free(result);
+            LLVMBuildRet(ctx->builder, value_of(fun_ctx, result));
+            hk_free(result);
         }
         else {
             // panik
-            fprintf(stderr, "ERROR - Function `%s` has no return value!\n", node->function_def.name);
-            exit(1);
+            LOG_ERROR(LOG_CODEGEN, "Function `%s` has no return value!\n", node->function_def.name);
+            compile_fail();
         }
         
-        emit(fun_ctx, "}\n");
+        finish_function(fun_ctx);
+        timer_end_span();
     }
    else if (node->type == AST_TYPE_DEF) {
-        // ... with types
-        char* types = get_constructor_types(ctx, node->type_decl.fields, node->type_decl.field_count);
-        int total_memory = get_total_memory(node->type_decl.fields, node->type_decl.field_count);
-        char* constructor_args = get_constructor_args(node->type_decl.fields, node->type_decl.field_count);
-
-        generate_vtable(ctx, node);
-
-        // define struct
-        if (node->type_decl.field_count == 0) {
-            emit(ctx, "%%struct.%s = type { %%struct.%s_vtable* }\n", node->type_decl.name, node->type_decl.name);
-        }
-        else {
-            emit(ctx, "%%struct.%s = type { %%struct.%s_vtable*, %s }\n", node->type_decl.name, node->type_decl.name, types);
-        }
-        emit(ctx, "\n");
-
-
-        // define constructor
-        emit(
-            ctx,
-            "define i8* @%s_constructor(%s) {\n",
-            node->type_decl.name,
-            constructor_args
-        );
-        emit(ctx, "  %%heap_ptr = call i8* @malloc(i32 %d)\n", total_memory);
-        emit(ctx, "  %%obj_ptr = bitcast i8* %%heap_ptr to %%struct.%s*\n", node->type_decl.name);
-
-        // Set vtable pointer
-        emit(ctx, "\n");
-        emit(ctx, "  %%vtable_ptr = getelementptr %%struct.%s, %%struct.%s* %%obj_ptr, i32 0, i32 0\n",
-             node->type_decl.name, node->type_decl.name);
-        emit(ctx, "  store %%struct.%s_vtable* @%s_vtable, %%struct.%s_vtable** %%vtable_ptr\n",
-             node->type_decl.name, node->type_decl.name, node->type_decl.name);
-        emit(ctx, "\n");
-
-        for (size_t i = 0; i < node->type_decl.field_count; i++) {
-            size_t field_index = i + 1; // +1 for vtable pointer
-            emit(
-                ctx,
-                "  %%%s_ptr = getelementptr %%struct.%s, %%struct.%s* %%obj_ptr, i32 0, i32 %zu\n",
-                node->type_decl.fields[i]->field_def.name,
-                node->type_decl.name,
-                node->type_decl.name,
-                field_index
-            );
-            emit(
-                ctx,
-                "  store %s %%%s, %s* %%%s_ptr\n",
-                joink_type(node->type_decl.fields[i]),
-                node->type_decl.fields[i]->field_def.name,
-                joink_type(node->type_decl.fields[i]),
-                node->type_decl.fields[i]->field_def.name
-            );
-        }
-        emit(ctx, "  ret i8* %%heap_ptr\n");
-        emit(ctx, "}\n", node->type_decl.name);
+        // ... with types (declared by _codegen_declarations)
+        LLVMValueRef vtable = generate_vtable(ctx, node);
+        generate_constructor(ctx, node, vtable);
 
         for (size_t i = 0; i < node->type_decl.method_count; i++) {
             if (node->type_decl.methods[i]->function_def.args_definitions[0]->type_info.kind == node->type_info.kind) {
@@ -970,9 +1168,14 @@ void codegen_stmt(CodegenContext* ctx, ASTNode* node) {
             }
         }
     }
+    else if (ctx->function == NULL) {
+        // semantic analysis moved every other statement into main
+        LOG_ERROR(LOG_CODEGEN, "Statement outside of a function (node_type=%d)\n", node->type);
+        compile_fail();
+    }
     else {
         char* temp = gen_expr(ctx, node);
-        free(temp);
+        hk_free(temp);
     }
 }
 
@@ -997,7 +1200,7 @@ static char* codegen_expr_block(CodegenContext* ctx, ASTNode* node) {
 void _codegen_declarations(CodegenContext* ctx, ASTNode *node) {
     if (!node) {return;}
 
-    fprintf(stderr, "Collecting declarations for node_type=%d \n", node->type);
+    LOG_DEBUG(LOG_CODEGEN, "Collecting declarations for node_type=%d \n", node->type);
 
     switch (node->type) {
         case AST_BLOCK: {
@@ -1007,23 +1210,38 @@ void _codegen_declarations(CodegenContext* ctx, ASTNode *node) {
             break;
         }
         case AST_STRING: {
+            // the characters as written, NUL-terminated
             char* escaped = node->string;
-            int length = strlen(escaped) + 1; // null-terminated
-            char* temp = new_label(ctx);
-            
-            emit(ctx, "@.str.%s = private unnamed_addr constant [%d x i8] c\"%s\\00\", align 1\n", temp, length, escaped);
-
-            
-            emit(ctx,
-                "@%s = alias i8, getelementptr inbounds ([%d x i8], [%d x i8]* @.str.%s, i64 0, i64 0)\n", temp, length, length, temp
-           );
-
-
-            const char* str_ptr = to_str_ptr(temp);
+            int label = new_label(ctx);
+            LLVMValueRef text = LLVMConstStringInContext(ctx->llvm, escaped, strlen(escaped), false);
+
+            char name[32];
+            sprintf(name, ".str.l%d", label);
+            LLVMValueRef global = LLVMAddGlobal(ctx->module, LLVMTypeOf(text), name);
+            LLVMSetInitializer(global, text);
+            LLVMSetGlobalConstant(global, true);
+            LLVMSetLinkage(global, LLVMPrivateLinkage);
+            LLVMSetUnnamedAddress(global, LLVMGlobalUnnamedAddr);
+            LLVMSetAlignment(global, 1);
+
+            // the program passes around a pointer to the first character,
+            // an alias so that llc reaches it through the GOT (PIE links)
+            LLVMValueRef zero = LLVMConstInt(LLVMInt64TypeInContext(ctx->llvm), 0, false);
+            LLVMValueRef indices[] = {zero, zero};
+            char* str_ptr = hk_malloc(32);
+            sprintf(str_ptr, "@l%d", label);
+            LLVMValueRef alias = LLVMAddAlias2(
+                ctx->module,
+                LLVMInt8TypeInContext(ctx->llvm),
+                0,
+                LLVMConstInBoundsGEP2(LLVMTypeOf(text), global, indices, 2),
+                llvm_name(str_ptr)
+            );
+            name_map_put(ctx->globals, str_ptr, alias);
 
+            // literals are not interned: every one is its own symbol,
+            // keyed by the node's copy that gen_expr looks up
             add_symbol(ctx, escaped, str_ptr, node);
-
-            free(str_ptr);
             break;
         }
         case AST_BINARY_OP: {
@@ -1037,14 +1255,14 @@ void _codegen_declarations(CodegenContext* ctx, ASTNode *node) {
         }
         case AST_METHOD_CALL: {
             for (size_t i = 0; i < node->method_call.arg_count; i++) {
-                fprintf(stderr, "%s %p\n", node->method_call.method, node->method_call.args[i]);
+                LOG_DEBUG(LOG_CODEGEN, "%s %p\n", node->method_call.method, node->method_call.args[i]);
                 _codegen_declarations(ctx, node->method_call.args[i]);
             }
             break;
         }
         case AST_FUNCTION_CALL: {
             for (size_t i = 0; i < node->function_call.arg_count; i++) {
-                fprintf(stderr, "%s %p\n", node->function_call.name, node->function_call.args[i]);
+                LOG_DEBUG(LOG_CODEGEN, "%s %p\n", node->function_call.name, node->function_call.args[i]);
                 _codegen_declarations(ctx, node->function_call.args[i]);
             }
             break;
@@ -1067,7 +1285,8 @@ void _codegen_declarations(CodegenContext* ctx, ASTNode *node) {
             break;
         }
         case AST_TYPE_DEF: {
-            // constructor && 
+            // struct and vtable types && constructor &&
+            declare_type(ctx, node);
             for (size_t i = 0; i < node->type_decl.method_count; i++) {
                 _codegen_declarations(ctx, node->type_decl.methods[i]);
             }
@@ -1083,24 +1302,48 @@ void _codegen_declarations(CodegenContext* ctx, ASTNode *node) {
     }
 }
 
-void codegen_declarations(CodegenContext* ctx, ASTNode *root) {
-    emit(ctx, "; ModuleID = 'memelang'\n");
-    emit(ctx, "declare double @max(double, double)\n");
-    emit(ctx, "declare double @min(double, double)\n");
-    emit(ctx, "declare double @pow(double, double)\n");
+static LLVMValueRef declare_builtin(CodegenContext* ctx, const char* name, LLVMTypeRef result, LLVMTypeRef* args, unsigned int arg_count) {
+    return LLVMAddFunction(ctx->module, name, LLVMFunctionType(result, args, arg_count, false));
+}
 
-    emit(ctx, "declare double @print(double)\n");
-    emit(ctx, "declare double @prints(i8* nocapture) nounwind\n");
-    emit(ctx, "declare i8* @malloc(i32)\n");
-    emit(ctx, "declare void @free(i8*)\n");
+static LLVMAttributeRef attribute(CodegenContext* ctx, const char* name) {
+    unsigned int kind = LLVMGetEnumAttributeKindForName(name, strlen(name));
+    return LLVMCreateEnumAttribute(ctx->llvm, kind, 0);
+}
+
+void codegen_declarations(CodegenContext* ctx, ASTNode *root) {
+    timer_begin(PASS_CODEGEN_DECLARATIONS);
+    LLVMTypeRef number = double_type(ctx);
+    LLVMTypeRef string = string_type(ctx);
+    LLVMTypeRef numbers[] = {number, number};
+    LLVMTypeRef size = LLVMInt32TypeInContext(ctx->llvm);
+    declare_builtin(ctx, "max", number, numbers, 2);
+    declare_builtin(ctx, "min", number, numbers, 2);
+    declare_builtin(ctx, "pow", number, numbers, 2);
+
+    declare_builtin(ctx, "print", number, numbers, 1);
+    LLVMValueRef prints = declare_builtin(ctx, "prints", number, &string, 1);
+    LLVMAddAttributeAtIndex(prints, 1, attribute(ctx, "nocapture"));
+    LLVMAddAttributeAtIndex(prints, LLVMAttributeFunctionIndex, attribute(ctx, "nounwind"));
+    declare_builtin(ctx, "malloc", string, &size, 1);
+    declare_builtin(ctx, "free", LLVMVoidTypeInContext(ctx->llvm), &string, 1);
 
     _codegen_declarations(ctx, root);
-    emit(ctx, "\n");
+    timer_end(PASS_CODEGEN_DECLARATIONS);
 }
 
-void codegen(CodegenContext* ctx, ASTNode* node) {
+typedef struct {
+    CodegenContext* ctx;
+    ASTNode* root;
+} Program;
+
+static void codegen_program(void* arg) {
+    Program* program = arg;
+    CodegenContext* ctx = program->ctx;
+    ASTNode* node = program->root;
+
     // only statement blocks for now
-    fprintf(stderr, "INFO - Generating LLVM IR code\n");
+    LOG_INFO(LOG_CODEGEN, "Generating LLVM IR code\n");
 
     codegen_declarations(ctx, node);
 
@@ -1113,21 +1356,49 @@ void codegen(CodegenContext* ctx, ASTNode* node) {
             break;
         }
     }
+
+    // what llc used to catch when it read the text back
+    char* message = NULL;
+    if (LLVMVerifyModule(ctx->module, LLVMReturnStatusAction, &message)) {
+        LOG_ERROR(LOG_CODEGEN, "Generated invalid IR:\n%s", message);
+        LLVMDisposeMessage(message);
+        compile_fail();
+    }
+    LLVMDisposeMessage(message);
+}
+
+bool codegen(CodegenContext* ctx, ASTNode* node) {
+    // half a module is of no use to anybody
+    Program program = {ctx, node};
+    if (!compile_guard(codegen_program, &program)) {
+        LLVMDisposeModule(ctx->module);
+        ctx->module = NULL;
+        return false;
+    }
+    return true;
 }
 
-void codegen_init(CodegenContext* ctx, FILE* output) {
-    ctx->output = output;
+void codegen_init(CodegenContext* ctx, LLVMContextRef llvm) {
+    ctx->llvm = llvm;
+    ctx->module = LLVMModuleCreateWithNameInContext("memelang", llvm);
+    ctx->builder = LLVMCreateBuilderInContext(llvm);
+    ctx->globals = hk_calloc(1, sizeof(NameMap));
+    ctx->function = NULL;
     ctx->temp_counter = 0;
     ctx->label_counter = 0;
     ctx->_last_merge = 0;
+    ctx->_last_merge_while = 0;
+    ctx->current_label = 0;
     ctx->symbols = NULL;
     ctx->symbols_size = 0;
+    ctx->symbols_capacity = 0;
 }
 
 void codegen_cleanup(CodegenContext* ctx) {
+    LLVMDisposeBuilder(ctx->builder);
     for (size_t i = 0; i < ctx->symbols_size; i++) {
-        free(ctx->symbols[i].name);
-        free(ctx->symbols[i].temp);
+        hk_free(ctx->symbols[i].name);
+        hk_free(ctx->symbols[i].temp);
     }
-    free(ctx->symbols);
+    hk_free(ctx->symbols);
 }
@@ -3,6 +3,7 @@
 
 #include "ast.h"
 #include <stdio.h>
+#include <stdbool.h>
 
 typedef struct {
     char* name;
@@ -14,6 +15,59 @@ typedef struct {
     ASTNode* node;
 } Symbol;
 
+#ifdef HELK_LLVM
+
+#include <llvm-c/Core.h>
+
+// temps ("%t3", "%x", "@l0") and labels ("l2") to what they stand for;
+// keys are not copied and live in the arena like the temps
+typedef struct {
+    const char** keys;
+    void** values;
+    size_t capacity; // a power of two (none until used)
+    size_t count;
+} NameMap;
+
+// A phi operand named before codegen reached its definition
+typedef struct PendingIncoming {
+    LLVMValueRef phi;
+    LLVMBasicBlockRef block;
+    struct PendingIncoming* next;
+} PendingIncoming;
+
+// The function instructions go to. A dry run builds into a scratch
+// function of its own that still sees the values of its parent
+typedef struct CodegenFunction {
+    LLVMValueRef function;
+    struct CodegenFunction* parent;
+    NameMap values;
+    NameMap blocks;
+    NameMap pending; // lists of PendingIncoming
+    bool dry;
+} CodegenFunction;
+
+typedef struct {
+    LLVMContextRef llvm;
+    LLVMModuleRef module;
+    LLVMBuilderRef builder;
+    NameMap* globals; // string literals
+    CodegenFunction* function; // NULL outside of function bodies
+    int temp_counter;
+    int label_counter;
+    int _last_merge; // required for nested ifs
+    int _last_merge_while;
+    int current_label;
+    Symbol* symbols;
+    size_t symbols_size;
+    size_t symbols_capacity;
+} CodegenContext;
+
+// The module is built in llvm
+void codegen_init(CodegenContext* ctx, LLVMContextRef llvm);
+
+#else
+
+// Without LLVM, codegen_text.c prints the IR to output instead
 typedef struct {
     FILE* output;
     int temp_counter;
@@ -23,15 +77,21 @@ typedef struct {
     int current_label;
     Symbol* symbols;
     size_t symbols_size;
+    size_t symbols_capacity;
 } CodegenContext;
 
 void codegen_init(CodegenContext* ctx, FILE* output);
+
+#endif
+
 void codegen_cleanup(CodegenContext* ctx);
 
 static char* gen_expr(CodegenContext* ctx, ASTNode* node);
 void gen_redefs(CodegenContext* ctx, ASTNode* node);
 static char* codegen_expr_block(CodegenContext* ctx, ASTNode* node);
 void codegen_block(CodegenContext* ctx, ASTNode* node);
-void codegen(CodegenContext* ctx, ASTNode* node);
+// Build ctx->module (or print it); on failure (false) the module is
+// disposed of and NULL
+bool codegen(CodegenContext* ctx, ASTNode* node);
 
 #endif
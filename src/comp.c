@@ -1,141 +1,276 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <errno.h>
 #include <string.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
 
-#include "lexer.h"
-#include "parser.h"
-#include "ast.h"
-#include "codegen.h"
-#include "semantic.h"
-
-Token* lexer(const char* input, int length, unsigned int* _num_tokens) {
-    LexerState* state = malloc(sizeof(LexerState));
-    Token* tokens = malloc(sizeof(Token)*0);
-    unsigned int num_tokens = 0;
-
-    lexer_init(state, input, length, true);
-
-    Token token;
-
-    while (state->current < state->end) {
-        token = lexer_next_token(state);
-        fprintf(stderr, "INFO - Ate token (%d, %s) [%d, %d] \n", token.type, token.value, token.line, token.column);
-        if (token.type == TOKEN_ERROR) {
-            fprintf(
-                stderr,
-                "ERROR - Invalid token %s (line=%d, column=%d)\n",
-                token.value,
-                token.line,
-                token.column
-            );
-            free(state);
-            free(tokens);
-            *_num_tokens = 0;
-            return NULL;
-        }
-        // modify external array
-        tokens = realloc(tokens, sizeof(Token) * (num_tokens + 1));
-        tokens[num_tokens] = token;
-        num_tokens += 1;
+#include "compiler.h"
+#include "server.h"
+#include "log.h"
+#include "timer.h"
+#include "jit.h"
+#include "backend.h"
 
-        // after to add EOF
-        if (token.type == TOKEN_EOF) {
-            free(state);
-            *_num_tokens = num_tokens;
-            return tokens;
-        }
-    }
-    free(state);
+typedef struct {
+    const char* path;
+    char* output_path;
+    const EmitOptions* emit;
+    // diagnostics are buffered per input and printed in input order
+    char* diagnostics;
+    size_t diagnostics_size;
+    bool ok;
+} Job;
 
-    *_num_tokens = num_tokens;
+typedef struct {
+    Job* jobs;
+    size_t count;
+    size_t next; // claimed atomically by the workers
+} JobQueue;
 
-    return tokens;
+static char* output_path_for(const char* outdir, const char* path, EmitKind kind) {
+    // outdir/<basename without extension>.ll (or .bc, .o, nothing)
+    const char* base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    const char* dot = strrchr(base, '.');
+    int base_length = dot ? (int) (dot - base) : (int) strlen(base);
+    const char* extension = emit_extension(kind);
 
+    char* result = malloc(strlen(outdir) + base_length + strlen(extension) + 2);
+    sprintf(result, "%s/%.*s%s", outdir, base_length, base, extension);
+    return result;
 }
 
-static char* read_file(const char* filename) {
-    struct stat st;
-    if (stat(filename, &st) == -1) {
-        fprintf(stderr, "Error: Could not stat file '%s' (%s)\n",
-               filename, strerror(errno));
-        return NULL;
+static void run_job(Job* job) {
+    FILE* diagnostics = open_memstream(&job->diagnostics, &job->diagnostics_size);
+
+    Compilation compilation;
+    compilation_init(&compilation, job->path, NULL, diagnostics);
+    // the cores are busy with the other inputs already
+    compilation.parse_threads = 1;
+    job->ok = emit_file(&compilation, job->output_path, job->emit, diagnostics);
+
+    fclose(diagnostics);
+}
+
+static void* worker(void* arg) {
+    JobQueue* queue = arg;
+    while (true) {
+        size_t index = __atomic_fetch_add(&queue->next, 1, __ATOMIC_RELAXED);
+        if (index >= queue->count) {
+            return NULL;
+        }
+        run_job(&queue->jobs[index]);
     }
+}
 
-    FILE* f = fopen(filename, "rb");
-    if (!f) {
-        fprintf(stderr, "Error: Could not open '%s' (%s)\n",
-               filename, strerror(errno));
-        return NULL;
+static int compile_batch(const char** paths, size_t count, const char* outdir, const EmitOptions* emit) {
+    Job* jobs = calloc(count, sizeof(Job));
+    for (size_t i = 0; i < count; i++) {
+        jobs[i].path = paths[i];
+        jobs[i].output_path = output_path_for(outdir, paths[i], emit->kind);
+        jobs[i].emit = emit;
+        // two inputs writing the same .ll would race
+        for (size_t j = 0; j < i; j++) {
+            if (strcmp(jobs[i].output_path, jobs[j].output_path) == 0) {
+                fprintf(stderr, "Error: '%s' and '%s' both compile to '%s'\n",
+                        jobs[j].path, jobs[i].path, jobs[i].output_path);
+                for (size_t k = 0; k <= i; k++) {
+                    free(jobs[k].output_path);
+                }
+                free(jobs);
+                return 1;
+            }
+        }
     }
 
-    char* buffer = malloc(st.st_size + 1);
-    if (!buffer) {
-        fclose(f);
-        fprintf(stderr, "Error: Memory allocation failed\n");
-        return NULL;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t thread_count = (cores > 0) ? (size_t) cores : 1;
+    if (thread_count > count) {
+        thread_count = count;
     }
 
-    long read = fread(buffer, 1, st.st_size, f);
-    if (read != st.st_size) {
-        free(buffer);
-        fclose(f);
-        fprintf(stderr, "Error: Read incomplete\n");
-        return NULL;
+    JobQueue queue = {jobs, count, 0};
+    pthread_t* threads = malloc(sizeof(pthread_t) * thread_count);
+    for (size_t i = 0; i < thread_count; i++) {
+        pthread_create(&threads[i], NULL, worker, &queue);
+    }
+    for (size_t i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
     }
+    free(threads);
 
-    buffer[st.st_size] = '\0';
-    fclose(f);
-    return buffer;
-}
+    size_t failed = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (jobs[i].diagnostics_size > 0) {
+            fprintf(stderr, "==> %s <==\n", jobs[i].path);
+            fwrite(jobs[i].diagnostics, 1, jobs[i].diagnostics_size, stderr);
+        }
+        if (!jobs[i].ok) {
+            failed += 1;
+        }
+        free(jobs[i].diagnostics);
+        free(jobs[i].output_path);
+    }
+    free(jobs);
 
-int main(int argc, char** argv) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <input-file>\n", argv[0]);
+    if (failed > 0) {
+        fprintf(stderr, "ERROR - %zu of %zu files failed to compile\n", failed, count);
         return 1;
     }
+    return 0;
+}
 
-    char* data = read_file(argv[1]);
-    if (!data) {
-        return 1;
+static int compile_single(const char* path, const char* output_path, const EmitOptions* emit) {
+    if (emit->kind == EMIT_LL && output_path == NULL) {
+        // straight to stdout
+        Compilation compilation;
+        compilation_init(&compilation, path, stdout, NULL);
+        return compile_file(&compilation) ? 0 : 1;
     }
 
+    Compilation compilation;
+    compilation_init(&compilation, path, NULL, NULL);
+    char* default_path = output_path ? NULL : output_path_for(".", path, emit->kind);
+    bool ok = emit_file(&compilation, output_path ? output_path : default_path, emit, stderr);
+    free(default_path);
+    return ok ? 0 : 1;
+}
+
+static int run_file(const char* path) {
+    Compilation compilation;
+    compilation_init(&compilation, path, NULL, NULL);
 
-    unsigned int num_tokens = 0;
-    Token* tokens = lexer(data, strlen(data), &num_tokens);
-    if (tokens == NULL) {
-        fprintf(stderr, "ERROR - Detected error(s) during tokenization\n");
-        exit(1);
+    int status = 1;
+    if (!jit_run(&compilation, &status)) {
+        status = 1;
     }
+    return status;
+}
 
-    for (unsigned int i = 0; i < num_tokens; i++) {
-        fprintf(stderr, "%s ", tokens[i].value);
+static bool finish_timers(const char* trace_path) {
+    timer_report(stderr);
+    if (trace_path && !timer_write_trace(trace_path)) {
+        fprintf(stderr, "Error: Could not write '%s'\n", trace_path);
+        return false;
     }
-    fprintf(stderr, "\n");
-
-    int errors = 0;
-    ASTNode* ast = parse(tokens, &errors);
-    ast_print_node(ast, 0);
-    if (errors > 0) {
-        fprintf(stderr, "ERROR - Found %d errors during parsing\n", errors);
-        exit(1);
+    return true;
+}
+
+static void usage(const char* program) {
+    fprintf(
+        stderr,
+        "Usage: %s [options] <input-file> [-o <output-file>]\n"
+        "       %s [options] --batch <input-file>... -o <outdir>\n"
+        "       %s [options] --serve <socket>\n"
+        "       %s [options] --run <input-file>\n"
+        "Options:\n"
+        "  -v, -vv            more tracing for every category\n"
+        "  --log=<list>       trace lex, parse, ast, sema, codegen or all\n"
+        "  --time-passes      print the time spent in every phase\n"
+        "  --trace=<file>     write a chrome://tracing profile\n"
+        "  --emit=<kind>      ll (default), bc, obj or exe (linked with builtins.o)\n"
+        "  --cpu=<name>       target CPU for bc, obj and exe; native for this one\n"
+        "  --features=<list>  target features, as in +avx2,-fma\n"
+        "  --runtime=<file>   builtins.o to link executables with\n",
+        program,
+        program,
+        program,
+        program
+    );
+}
+
+int main(int argc, char** argv) {
+    const char** inputs = malloc(sizeof(char*) * argc);
+    size_t input_count = 0;
+    const char* output_path = NULL; // a directory in batch mode
+    const char* socket_path = NULL;
+    const char* trace_path = NULL;
+    bool time_passes = false;
+    bool batch = false;
+    bool run = false;
+    EmitOptions emit = {EMIT_LL, NULL, NULL, NULL};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            log_set_verbosity(1);
+        }
+        else if (strcmp(argv[i], "-vv") == 0) {
+            log_set_verbosity(2);
+        }
+        else if (strncmp(argv[i], "--log=", 6) == 0) {
+            if (!log_configure(argv[i] + 6)) {
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--time-passes") == 0) {
+            time_passes = true;
+        }
+        else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            trace_path = argv[i] + 8;
+        }
+        else if (strncmp(argv[i], "--emit=", 7) == 0) {
+            if (!emit_parse_kind(argv[i] + 7, &emit.kind)) {
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], "--cpu=", 6) == 0) {
+            emit.cpu = argv[i] + 6;
+        }
+        else if (strncmp(argv[i], "--features=", 11) == 0) {
+            emit.features = argv[i] + 11;
+        }
+        else if (strncmp(argv[i], "--runtime=", 10) == 0) {
+            emit.runtime = argv[i] + 10;
+        }
+        else if (strcmp(argv[i], "--run") == 0) {
+            run = true;
+        }
+        else if (strcmp(argv[i], "--batch") == 0) {
+            batch = true;
+        }
+        else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        }
+        else if (argv[i][0] != '-') {
+            inputs[input_count++] = argv[i];
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
     }
 
-    CodegenContext ctx;
-    codegen_init(&ctx, stdout);
+    timer_enable(time_passes, trace_path != NULL);
 
-    bool res = semantic_analysis(ast);
+    if (socket_path != NULL) {
+        if (batch || run || input_count > 0 || output_path != NULL) {
+            usage(argv[0]);
+            return 1;
+        }
+        free(inputs);
+        return serve(socket_path);
+    }
 
-    if (res) {
-        codegen(&ctx, ast);
-        codegen_cleanup(&ctx);
+    if (batch) {
+        if (run || input_count == 0 || output_path == NULL) {
+            usage(argv[0]);
+            return 1;
+        }
+        int status = compile_batch(inputs, input_count, output_path, &emit);
+        free(inputs);
+        return finish_timers(trace_path) ? status : 1;
     }
-    else {
-        fprintf(stderr, "FATAL - Semantic Analysis failed! Can not generate correct code\n");
+
+    if (input_count != 1 || (run && output_path != NULL)) {
+        usage(argv[0]);
+        return 1;
     }
 
-    return 0;
+    int status = run ? run_file(inputs[0]) : compile_single(inputs[0], output_path, &emit);
+    free(inputs);
+    return finish_timers(trace_path) ? status : 1;
 }
@@ -0,0 +1,279 @@
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+
+#include "compiler.h"
+#include "frontend.h"
+#include "ast.h"
+#include "codegen.h"
+#include "semantic.h"
+#include "log.h"
+#include "timer.h"
+#ifdef HELK_LLVM
+#include <llvm-c/Core.h>
+#endif
+
+// the compilation running on this thread (for compile_fail)
+static _Thread_local Compilation* current = NULL;
+// innermost compile_guard() on this thread, ahead of current
+static _Thread_local jmp_buf* guard = NULL;
+
+typedef struct {
+    char* data;
+    size_t length;
+    bool mapped;
+} SourceBuffer;
+
+static bool read_file(const char* filename, SourceBuffer* source) {
+    /*
+     * Map the file instead of copying it; tokens are slices into the mapping.
+     * The lexer reads the byte at the end (a '\0' ends every token and
+     * run there) so we rely on the zero-filled tail of the last page. If
+     * the file fills its last page exactly (or is empty) there is no such
+     * tail and we fall back to a NUL-terminated copy.
+     */
+    struct stat st;
+    if (stat(filename, &st) == -1) {
+        fprintf(log_file(), "Error: Could not stat file '%s' (%s)\n",
+               filename, strerror(errno));
+        return false;
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        fprintf(log_file(), "Error: Could not open '%s' (%s)\n",
+               filename, strerror(errno));
+        return false;
+    }
+
+    source->length = st.st_size;
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    if (st.st_size > 0 && (st.st_size % page_size) != 0) {
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            close(fd);
+            source->data = data;
+            source->mapped = true;
+            return true;
+        }
+    }
+
+    char* buffer = malloc(st.st_size + 1);
+    if (!buffer) {
+        close(fd);
+        fprintf(log_file(), "Error: Memory allocation failed\n");
+        return false;
+    }
+
+    long total = 0;
+    while (total < st.st_size) {
+        long n = read(fd, buffer + total, st.st_size - total);
+        if (n <= 0) {
+            free(buffer);
+            close(fd);
+            fprintf(log_file(), "Error: Read incomplete\n");
+            return false;
+        }
+        total += n;
+    }
+
+    buffer[st.st_size] = '\0';
+    close(fd);
+    source->data = buffer;
+    source->mapped = false;
+    return true;
+}
+
+static void release_file(SourceBuffer* source) {
+    if (source->mapped) {
+        munmap(source->data, source->length);
+    }
+    else {
+        free(source->data);
+    }
+}
+
+void compilation_init(Compilation* compilation, const char* path, FILE* output, FILE* diagnostics) {
+    compilation->path = path;
+    compilation->output = output;
+    compilation->diagnostics = diagnostics;
+    compilation->prelude = NULL;
+    compilation->parse_threads = 0;
+    compilation->llvm = NULL;
+    compilation->module = NULL;
+    compilation->errors = 0;
+    arena_init(&compilation->arena);
+    intern_table_init(&compilation->names);
+}
+
+void compile_fail(void) {
+    if (guard != NULL) {
+        longjmp(*guard, 1);
+    }
+    if (current == NULL) {
+        exit(1);
+    }
+    current->errors += 1;
+    longjmp(current->fail, 1);
+}
+
+bool compile_guard(void (*body)(void*), void* arg) {
+    jmp_buf target;
+    jmp_buf* outer = guard;
+    guard = &target;
+    bool ok = setjmp(target) == 0;
+    if (ok) {
+        body(arg);
+    }
+    guard = outer;
+    return ok;
+}
+
+#ifdef HELK_LLVM
+typedef struct {
+    CodegenContext ctx;
+    ASTNode* ast;
+    FILE* output;
+    bool ok;
+} CodegenRun;
+
+static void codegen_run(void* arg) {
+    CodegenRun* run = arg;
+    run->ok = codegen(&run->ctx, run->ast);
+    if (run->ok && run->output != NULL) {
+        char* ir = LLVMPrintModuleToString(run->ctx.module);
+        fputs(ir, run->output);
+        LLVMDisposeMessage(ir);
+    }
+}
+#endif
+
+static bool run_pipeline(Compilation* compilation, const char* source, size_t length) {
+    // lexing happens on demand while parsing
+    int errors = 0;
+    timer_begin(PASS_PARSE);
+    ASTNode* ast = frontend_parse(compilation, source, length, &errors);
+    timer_end(PASS_PARSE);
+    if (log_enabled(LOG_AST, LOG_LEVEL_DEBUG)) {
+        ast_print_node(ast, 0);
+    }
+    if (errors > 0) {
+        LOG_ERROR(LOG_PARSE, "Found %d errors during parsing\n", errors);
+        compilation->errors += errors;
+        return false;
+    }
+
+    if (compilation->prelude != NULL) {
+        prelude_reset(compilation->prelude);
+    }
+    if (!semantic_analysis(ast, compilation->prelude)) {
+        LOG_ERROR(LOG_SEMA, "Semantic Analysis failed! Can not generate correct code\n");
+        compilation->errors += 1;
+        return false;
+    }
+
+#ifdef HELK_LLVM
+    LLVMContextRef llvm = compilation->llvm ? compilation->llvm : LLVMContextCreate();
+    CodegenRun run = {.ast = ast, .output = compilation->output, .ok = false};
+    codegen_init(&run.ctx, llvm);
+    timer_begin(PASS_CODEGEN);
+    // a compile_fail() in there must not skip the disposal below
+    bool ok = compile_guard(codegen_run, &run) && run.ok;
+    timer_end(PASS_CODEGEN);
+    codegen_cleanup(&run.ctx);
+
+    if (ok && compilation->output == NULL && compilation->llvm != NULL) {
+        compilation->module = run.ctx.module;
+    }
+    else if (run.ctx.module != NULL) {
+        LLVMDisposeModule(run.ctx.module);
+    }
+    if (compilation->llvm == NULL) {
+        LLVMContextDispose(llvm);
+    }
+#else
+    CodegenContext ctx;
+    codegen_init(&ctx, compilation->output);
+    timer_begin(PASS_CODEGEN);
+    bool ok = codegen(&ctx, ast);
+    timer_end(PASS_CODEGEN);
+    codegen_cleanup(&ctx);
+#endif
+
+    if (!ok) {
+        compilation->errors += 1;
+        return false;
+    }
+    return true;
+}
+
+static void finish(Compilation* compilation) {
+    LOG_DEBUG(LOG_AST, "%zu bytes allocated for '%s'\n", compilation->arena.allocated, compilation->path);
+    current = NULL;
+    log_set_file(NULL);
+    timer_flush();
+    arena_set_current(NULL);
+    arena_release(&compilation->arena);
+    intern_set_current(NULL);
+    intern_table_release(&compilation->names);
+    line_index_set_current(NULL);
+    line_index_release(&compilation->lines);
+}
+
+bool compile_source(Compilation* compilation, const char* source, size_t length) {
+    if (source[length] != '\0') {
+        FILE* diagnostics = compilation->diagnostics ? compilation->diagnostics : stderr;
+        fprintf(diagnostics, "Error: Source of '%s' is not NUL-terminated\n", compilation->path);
+        compilation->errors += 1;
+        return false;
+    }
+    if (length > UINT_MAX) {
+        // tokens, AST nodes and the line index keep unsigned int offsets
+        FILE* diagnostics = compilation->diagnostics ? compilation->diagnostics : stderr;
+        fprintf(diagnostics, "Error: '%s' is too big (4 GiB or more)\n", compilation->path);
+        compilation->errors += 1;
+        return false;
+    }
+    current = compilation;
+    log_set_file(compilation->diagnostics);
+    arena_set_current(&compilation->arena);
+    intern_set_current(&compilation->names);
+    line_index_init(&compilation->lines, source, length);
+    line_index_set_current(&compilation->lines);
+
+    if (setjmp(compilation->fail) != 0) {
+        // compile_fail() somewhere down the pipeline
+        finish(compilation);
+        return false;
+    }
+    timer_begin_span(compilation->path);
+    bool ok = run_pipeline(compilation, source, length);
+    timer_end_span();
+
+    finish(compilation);
+    return ok;
+}
+
+bool compile_file(Compilation* compilation) {
+    SourceBuffer source;
+
+    log_set_file(compilation->diagnostics);
+    bool ok = read_file(compilation->path, &source);
+    log_set_file(NULL);
+    if (!ok) {
+        compilation->errors += 1;
+        return false;
+    }
+
+    // the AST owns copies of everything it needs
+    ok = compile_source(compilation, source.data, source.length);
+    release_file(&source);
+    return ok;
+}
@@ -0,0 +1,55 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include "arena.h"
+#include "lines.h"
+#include "intern.h"
+
+// A single source file on its way to LLVM IR.
+// The pipeline keeps no state outside of it, so several compilations
+// can run at the same time as long as each one stays on its thread
+typedef struct {
+    const char* path;
+    FILE* output;      // LLVM IR as text; NULL keeps the module (see llvm)
+    FILE* diagnostics; // errors and tracing; NULL means stderr
+    // builtins kept around between compilations; NULL builds fresh ones
+    struct SymbolTable* prelude;
+    // AST, types, symbols and strings; gone once the IR is out
+    Arena arena;
+    // names of this program; the prelude's stay in the process-wide table
+    InternTable names;
+    // line starts, built when a message first needs a position
+    LineIndex lines;
+    // threads for lexing and parsing big inputs; 0 picks one per core
+    // (or HELK_PARSE_THREADS), 1 keeps it all on the calling thread
+    int parse_threads;
+    // with no output, codegen builds in this (the caller's) LLVM context
+    // and leaves the module for the caller to dispose of; NULL builds in
+    // a context of the compilation's own
+    struct LLVMOpaqueContext* llvm;
+    struct LLVMOpaqueModule* module;
+    int errors;
+    jmp_buf fail;
+} Compilation;
+
+void compilation_init(Compilation* compilation, const char* path, FILE* output, FILE* diagnostics);
+// source[length] must be '\0': the lexer stops at it instead of
+// checking the length (see scan.h). Anything else is refused,
+// and so are sources of 4 GiB or more
+bool compile_source(Compilation* compilation, const char* source, size_t length);
+bool compile_file(Compilation* compilation);
+
+// Abandon the compilation running on this thread (the old exit(1)).
+// Outside of a compilation it still exits the process
+void compile_fail(void) __attribute__((noreturn));
+
+// Run body(arg) so that a compile_fail() inside it only returns false
+// from here; for helper threads of a compilation (see frontend.h) and
+// passes that clean up after themselves (see codegen.h)
+bool compile_guard(void (*body)(void*), void* arg);
+
+#endif
@@ -0,0 +1,191 @@
+#include "frontend.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "lexer.h"
+#include "parser.h"
+#include "arena.h"
+#include "lines.h"
+#include "intern.h"
+#include "log.h"
+#include "timer.h"
+
+// smaller inputs are not worth a thread
+#define MIN_PART_SIZE (64 * 1024)
+#define MAX_PARTS 64
+
+typedef struct {
+    const char* source;
+    size_t start;
+    size_t end;
+    LineIndex* lines;
+    InternTable* names;
+    Arena arena;
+    ASTNode* block;
+    int errors;
+    // replayed in order, or dropped when we parse again serially
+    char* diagnostics;
+    size_t diagnostics_size;
+} Part;
+
+size_t frontend_split(const char* source, size_t length, size_t target, size_t* ends, size_t max_parts) {
+    size_t count = 0;
+    size_t start = 0;
+    int depth = 0;
+    for (size_t i = 0; i < length && count + 1 < max_parts; i++) {
+        switch (source[i]) {
+            case '"':
+                // to the closing quote, escapes included
+                for (i++; i < length && source[i] != '"'; i++) {
+                    if (source[i] == '\\') {
+                        i++;
+                    }
+                }
+                break;
+            case '{':
+            case '(':
+                depth += 1;
+                break;
+            case '}':
+            case ')':
+                depth -= 1;
+                break;
+            case ';':
+                if (depth == 0 && i + 1 - start >= target) {
+                    ends[count++] = i + 1;
+                    start = i + 1;
+                }
+                break;
+        }
+    }
+    ends[count++] = length;
+    return count;
+}
+
+static ASTNode* parse_range(const char* source, size_t start, size_t end, int* errors) {
+    LexerState lexer;
+    lexer_init(&lexer, source, end);
+    // offsets stay relative to the whole file
+    lexer.current = source + start;
+    return parse(&lexer, errors);
+}
+
+static void parse_part_body(void* arg) {
+    Part* part = arg;
+    part->block = parse_range(part->source, part->start, part->end, &part->errors);
+}
+
+static void* parse_part(void* arg) {
+    Part* part = arg;
+    FILE* diagnostics = open_memstream(&part->diagnostics, &part->diagnostics_size);
+    log_set_file(diagnostics);
+    arena_set_current(&part->arena);
+    intern_set_current(part->names);
+    line_index_set_current(part->lines);
+
+    // only in the trace: the parse row already has the whole parse
+    timer_begin_span("parse part");
+    // grammar actions may give up on the whole compilation
+    if (!compile_guard(parse_part_body, part)) {
+        part->block = NULL;
+        part->errors += 1;
+    }
+    timer_end_span();
+
+    timer_flush();
+    line_index_set_current(NULL);
+    intern_set_current(NULL);
+    arena_set_current(NULL);
+    log_set_file(NULL);
+    fclose(diagnostics);
+    return NULL;
+}
+
+static size_t part_count(Compilation* compilation, size_t length) {
+    long threads = compilation->parse_threads;
+    if (threads == 0) {
+        const char* wanted = getenv("HELK_PARSE_THREADS");
+        threads = wanted ? atol(wanted) : sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (threads > MAX_PARTS) {
+        threads = MAX_PARTS;
+    }
+    if (threads > (long) (length / MIN_PART_SIZE)) {
+        threads = length / MIN_PART_SIZE;
+    }
+    return threads > 1 ? (size_t) threads : 1;
+}
+
+static ASTNode* parse_parts(Compilation* compilation, const char* source, size_t* ends, size_t count, int* errors) {
+    Part* parts = calloc(count, sizeof(Part));
+    pthread_t* threads = malloc(sizeof(pthread_t) * count);
+    for (size_t i = 0; i < count; i++) {
+        parts[i].source = source;
+        parts[i].start = (i == 0) ? 0 : ends[i - 1];
+        parts[i].end = ends[i];
+        parts[i].lines = &compilation->lines;
+        parts[i].names = &compilation->names;
+        arena_init(&parts[i].arena);
+        pthread_create(&threads[i], NULL, parse_part, &parts[i]);
+    }
+
+    int part_errors = 0;
+    size_t statements = 0;
+    for (size_t i = 0; i < count; i++) {
+        pthread_join(threads[i], NULL);
+        part_errors += parts[i].errors;
+        if (parts[i].block != NULL) {
+            statements += parts[i].block->block.stmt_count;
+        }
+    }
+
+    ASTNode* program = NULL;
+    if (part_errors == 0) {
+        ASTNode** block = hk_malloc(sizeof(ASTNode*) * statements);
+        size_t index = 0;
+        for (size_t i = 0; i < count; i++) {
+            fwrite(parts[i].diagnostics, 1, parts[i].diagnostics_size, log_file());
+            if (parts[i].block != NULL) {
+                memcpy(block + index, parts[i].block->block.statements, sizeof(ASTNode*) * parts[i].block->block.stmt_count);
+                index += parts[i].block->block.stmt_count;
+            }
+        }
+        program = create_ast_block(block, statements);
+        LOG_INFO(LOG_PARSE, "Joined %zu parts into one program block\n", count);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (program != NULL) {
+            // the nodes live on with the compilation
+            arena_merge(&compilation->arena, &parts[i].arena);
+        }
+        else {
+            arena_release(&parts[i].arena);
+        }
+        free(parts[i].diagnostics);
+    }
+    free(threads);
+    free(parts);
+
+    *errors = part_errors;
+    return program;
+}
+
+ASTNode* frontend_parse(Compilation* compilation, const char* source, size_t length, int* errors) {
+    size_t count = part_count(compilation, length);
+    if (count > 1) {
+        size_t ends[MAX_PARTS];
+        count = frontend_split(source, length, length / count, ends, count);
+        if (count > 1) {
+            ASTNode* program = parse_parts(compilation, source, ends, count, errors);
+            if (*errors == 0) {
+                return program;
+            }
+            // error recovery may cross a cut; report what a serial parse does
+            LOG_INFO(LOG_PARSE, "Parsing again on one thread for the diagnostics\n");
+        }
+    }
+    return parse_range(source, 0, length, errors);
+}
@@ -0,0 +1,23 @@
+#ifndef FRONTEND_H
+#define FRONTEND_H
+
+#include <stddef.h>
+#include "ast.h"
+#include "compiler.h"
+
+/*
+ * Lex and parse a whole source file. Big inputs are cut at top-level
+ * semicolons and the pieces are parsed on their own threads, then
+ * joined into one program block in source order. source[length] must
+ * be '\0' (see compile_source).
+ */
+ASTNode* frontend_parse(Compilation* compilation, const char* source, size_t length, int* errors);
+
+/*
+ * Offsets just past the top-level ';' that end each of (at most
+ * max_parts) pieces of about target bytes; the last one is length.
+ * Braces, parentheses and string literals are skipped over.
+ */
+size_t frontend_split(const char* source, size_t length, size_t target, size_t* ends, size_t max_parts);
+
+#endif
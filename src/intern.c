@@ -0,0 +1,152 @@
+#include "intern.h"
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define INITIAL_CAPACITY 64
+
+typedef struct {
+    size_t hash;
+    size_t length;
+} InternHeader;
+
+// names interned outside of a compilation (the server's prelude)
+static InternTable process_table;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static _Thread_local InternTable* current = NULL;
+
+static void init_process_table(void) {
+    intern_table_init(&process_table);
+}
+
+void intern_table_init(InternTable* table) {
+    for (int i = 0; i < INTERN_SHARD_COUNT; i++) {
+        InternShard* shard = &table->shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->slots = NULL;
+        shard->capacity = 0;
+        shard->count = 0;
+        arena_init(&shard->strings);
+    }
+}
+
+void intern_table_release(InternTable* table) {
+    for (int i = 0; i < INTERN_SHARD_COUNT; i++) {
+        InternShard* shard = &table->shards[i];
+        pthread_mutex_destroy(&shard->lock);
+        free(shard->slots);
+        arena_release(&shard->strings);
+    }
+}
+
+void intern_set_current(InternTable* table) {
+    current = table;
+}
+
+static InternHeader* header_of(const char* name) {
+    return (InternHeader*) name - 1;
+}
+
+static size_t hash_n(const char* s, size_t length) {
+    size_t h = 5381;
+    for (size_t i = 0; i < length; i++) {
+        h = ((h << 5) + h) + s[i];
+    }
+    return h;
+}
+
+static size_t slot_for(const InternShard* shard, size_t hash) {
+    // the low bits already picked the shard
+    return (hash / INTERN_SHARD_COUNT) & (shard->capacity - 1);
+}
+
+// the slot holding the name, or the empty one it would go into
+static size_t probe(const InternShard* shard, const char* s, size_t length, size_t hash) {
+    size_t i = slot_for(shard, hash);
+    for (char* name = shard->slots[i]; name; name = shard->slots[i]) {
+        InternHeader* header = header_of(name);
+        if (header->hash == hash && header->length == length && memcmp(name, s, length) == 0) {
+            return i;
+        }
+        i = (i + 1) & (shard->capacity - 1);
+    }
+    return i;
+}
+
+static void grow(InternShard* shard) {
+    size_t capacity = shard->capacity * 2;
+    char** slots = calloc(capacity, sizeof(char*));
+    char** old = shard->slots;
+    size_t old_capacity = shard->capacity;
+
+    shard->slots = slots;
+    shard->capacity = capacity;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i] == NULL) {
+            continue;
+        }
+        size_t j = slot_for(shard, header_of(old[i])->hash);
+        while (slots[j]) {
+            j = (j + 1) & (capacity - 1);
+        }
+        slots[j] = old[i];
+    }
+    free(old);
+}
+
+char* intern_n(const char* s, size_t length) {
+    pthread_once(&once, init_process_table);
+
+    size_t hash = hash_n(s, length);
+    InternTable* table = current ? current : &process_table;
+    if (table != &process_table) {
+        // nothing adds to it while compilations run, so no lock
+        const InternShard* shared = &process_table.shards[hash % INTERN_SHARD_COUNT];
+        if (shared->slots) {
+            char* name = shared->slots[probe(shared, s, length, hash)];
+            if (name) {
+                return name;
+            }
+        }
+    }
+
+    InternShard* shard = &table->shards[hash % INTERN_SHARD_COUNT];
+    pthread_mutex_lock(&shard->lock);
+    if (shard->slots == NULL) {
+        shard->slots = calloc(INITIAL_CAPACITY, sizeof(char*));
+        shard->capacity = INITIAL_CAPACITY;
+    }
+    size_t i = probe(shard, s, length, hash);
+    char* name = shard->slots[i];
+    if (name == NULL) {
+        // not the compilation's arena: a split parse drops the arenas of
+        // its parts when one fails, and the names must stay
+        InternHeader* header = arena_alloc(&shard->strings, sizeof(InternHeader) + length + 1);
+        header->hash = hash;
+        header->length = length;
+        name = (char*) (header + 1);
+        memcpy(name, s, length);
+        name[length] = '\0';
+
+        shard->slots[i] = name;
+        shard->count += 1;
+        if (shard->count * 2 > shard->capacity) {
+            grow(shard);
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return name;
+}
+
+char* intern(const char* s) {
+    return intern_n(s, strlen(s));
+}
+
+size_t intern_hash(const char* name) {
+    return header_of(name)->hash;
+}
+
+size_t intern_length(const char* name) {
+    return header_of(name)->length;
+}
@@ -0,0 +1,50 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include "arena.h"
+
+/*
+ * Interned names: identifiers, type and method names are resolved to a
+ * single copy once (by the parser), so two names are equal exactly when
+ * they are the same pointer. The hash and length live in front of the
+ * characters and are never recomputed.
+ *
+ * Every compilation interns into a table of its own, released with it
+ * (see intern_set_current). Names interned outside of any compilation,
+ * like the server's prelude, go to a process-wide table that compilations
+ * look at first, without locking: it may only grow while no compilation
+ * runs. Interned strings must not be modified or freed.
+ */
+
+// the parts of a split parse intern at the same time; spread them over a few locks
+#define INTERN_SHARD_COUNT 16
+
+typedef struct {
+    pthread_mutex_t lock;
+    char** slots; // open addressing, capacity is a power of two (none until used)
+    size_t capacity;
+    size_t count;
+    Arena strings;
+} InternShard;
+
+typedef struct {
+    InternShard shards[INTERN_SHARD_COUNT];
+} InternTable;
+
+void intern_table_init(InternTable* table);
+void intern_table_release(InternTable* table);
+
+// Names interned on this thread go to this table (NULL for the process-wide one)
+void intern_set_current(InternTable* table);
+
+char* intern(const char* s);
+char* intern_n(const char* s, size_t length);
+
+// Only for strings returned by intern(): these read the header in front
+// of the characters, which any other string does not have
+size_t intern_hash(const char* name);
+size_t intern_length(const char* name);
+
+#endif
@@ -0,0 +1,125 @@
+#include "jit.h"
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef HELK_LLVM
+
+#include "builtins.h"
+#include <stdlib.h>
+#include <math.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/Error.h>
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Orc.h>
+#include <llvm-c/Target.h>
+
+static bool failed(LLVMErrorRef error) {
+    if (error == NULL) {
+        return false;
+    }
+    char* message = LLVMGetErrorMessage(error);
+    fprintf(stderr, "Error: %s\n", message);
+    LLVMDisposeErrorMessage(message);
+    return true;
+}
+
+static LLVMErrorRef define_host_symbols(LLVMOrcLLJITRef jit, LLVMOrcJITDylibRef dylib) {
+    // everything codegen_declarations() declares comes from this binary
+    struct {
+        const char* name;
+        uintptr_t address;
+    } symbols[] = {
+        {"print", (uintptr_t) print},
+        {"prints", (uintptr_t) prints},
+        {"max", (uintptr_t) max},
+        {"min", (uintptr_t) min},
+        {"pow", (uintptr_t) pow},
+        {"malloc", (uintptr_t) malloc},
+        {"free", (uintptr_t) free},
+    };
+    size_t count = sizeof(symbols) / sizeof(symbols[0]);
+
+    LLVMJITCSymbolMapPair pairs[sizeof(symbols) / sizeof(symbols[0])];
+    for (size_t i = 0; i < count; i++) {
+        pairs[i].Name = LLVMOrcLLJITMangleAndIntern(jit, symbols[i].name);
+        pairs[i].Sym = (LLVMJITEvaluatedSymbol) {
+            symbols[i].address,
+            {LLVMJITSymbolGenericFlagsExported | LLVMJITSymbolGenericFlagsCallable, 0},
+        };
+    }
+
+    LLVMOrcMaterializationUnitRef unit = LLVMOrcAbsoluteSymbols(pairs, count);
+    LLVMErrorRef error = LLVMOrcJITDylibDefine(dylib, unit);
+    if (error) {
+        // still ours when the definition was refused
+        LLVMOrcDisposeMaterializationUnit(unit);
+        return error;
+    }
+
+    // and whatever the backend calls on its own (frem becomes fmod)
+    LLVMOrcDefinitionGeneratorRef generator;
+    error = LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(
+        &generator,
+        LLVMOrcLLJITGetGlobalPrefix(jit),
+        NULL,
+        NULL
+    );
+    if (error == NULL) {
+        LLVMOrcJITDylibAddGenerator(dylib, generator);
+    }
+    return error;
+}
+
+bool jit_run(Compilation* compilation, int* status) {
+    LLVMInitializeNativeTarget();
+    LLVMInitializeNativeAsmPrinter();
+
+    LLVMOrcThreadSafeContextRef context = LLVMOrcCreateNewThreadSafeContext();
+    compilation->llvm = LLVMOrcThreadSafeContextGetContext(context);
+    bool compiled = compile_file(compilation);
+    compilation->llvm = NULL;
+    if (!compiled) {
+        LLVMOrcDisposeThreadSafeContext(context);
+        return false;
+    }
+    LLVMOrcThreadSafeModuleRef thread_safe_module = LLVMOrcCreateNewThreadSafeModule(compilation->module, context);
+    compilation->module = NULL;
+    // the module keeps its context alive
+    LLVMOrcDisposeThreadSafeContext(context);
+
+    LLVMOrcLLJITRef jit;
+    if (failed(LLVMOrcCreateLLJIT(&jit, NULL))) {
+        LLVMOrcDisposeThreadSafeModule(thread_safe_module);
+        return false;
+    }
+
+    bool ok = false;
+    LLVMOrcJITDylibRef dylib = LLVMOrcLLJITGetMainJITDylib(jit);
+    if (failed(define_host_symbols(jit, dylib))) {
+        LLVMOrcDisposeThreadSafeModule(thread_safe_module);
+    }
+    else if (!failed(LLVMOrcLLJITAddLLVMIRModule(jit, dylib, thread_safe_module))) {
+        LLVMOrcExecutorAddress address;
+        if (!failed(LLVMOrcLLJITLookup(jit, &address, "main"))) {
+            int (*main_function)(void) = (int (*)(void)) (uintptr_t) address;
+            *status = main_function();
+            // the program prints through our stdio
+            fflush(stdout);
+            ok = true;
+        }
+    }
+
+    failed(LLVMOrcDisposeLLJIT(jit));
+    return ok;
+}
+
+#else
+
+bool jit_run(Compilation* compilation, int* status) {
+    (void) compilation;
+    (void) status;
+    fprintf(stderr, "Error: --run needs a compiler built with LLVM (see LLVM_CONFIG in the Makefile)\n");
+    return false;
+}
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdbool.h>
+#include "compiler.h"
+
+/*
+ * Compile the file of compilation (set up with no output) and run it
+ * without leaving the process: codegen builds the module straight into
+ * a context of LLVM's ORC JIT, with the builtins (and pow, malloc and
+ * free) bound to the ones compiled into this binary. *status gets what
+ * main returned.
+ *
+ * Only available when built against LLVM (HELK_LLVM).
+ */
+bool jit_run(Compilation* compilation, int* status);
+
+#endif
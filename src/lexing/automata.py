@@ -1,4 +1,5 @@
 from pathlib import Path
+from bisect import bisect_right
 from collections import deque, defaultdict
 from dataclasses import dataclass, field
 from typing import Dict, Set, FrozenSet, List, Tuple, Optional
@@ -9,8 +10,13 @@ from lexing.condition import (
     CharSetCondition,
     WildcardCondition,
     MetaCharCondition,
+    Ranges,
+    merge_ranges,
 )
 
+# an inclusive range of bytes
+ByteRange = Tuple[int, int]
+
 
 @dataclass
 class NFAState:
@@ -23,7 +29,8 @@ class NFAState:
     token_type: Optional[str] = None
     # traks the priority of the pattern; not used but it's okay to keep it around
     pattern_index: Optional[int] = None
-    char_transitions: Dict[Condition, Set["NFAState"]] = field(default_factory=dict)
+    # byte range -> targets; the ranges of one state may overlap
+    char_transitions: Dict[ByteRange, Set["NFAState"]] = field(default_factory=dict)
     epsilon_transitions: Set["NFAState"] = field(default_factory=set)
 
     # notice we can not compare states directly
@@ -50,14 +57,23 @@ class NFA:
         """Create NFA for a single character condition."""
         start = NFAState(0)
         end = NFAState(1, is_accepting=True)
-        # OR
-        # no need to add a bunch of epsilon transitions
-        # for this
-        for symbol in condition.expand():
-            start.char_transitions[symbol] = {end}
         nfa = NFA(start, end)
         nfa.add_state(start)
         nfa.add_state(end)
+        # OR
+        # no need to add a bunch of epsilon transitions
+        # for this
+        # one byte per step: code points past ASCII are a path through
+        # their UTF-8 encoding (a lead byte, then continuation bytes)
+        for sequence in condition.byte_sequences():
+            state = start
+            for index, (low, high) in enumerate(sequence):
+                target = end
+                if index < len(sequence) - 1:
+                    target = NFAState(2)
+                    nfa.add_state(target)
+                state.char_transitions.setdefault((low, high), set()).add(target)
+                state = target
         return nfa
 
     @staticmethod
@@ -134,16 +150,18 @@ class NFA:
 class DFAConverter:
     """Converts NFA to DFA using subset construction algorithm."""
 
-    def __init__(self, nfa: NFA, alphabet: Set[str]):
+    def __init__(self, nfa: NFA, alphabet: Optional[Set[str]] = None):
         """
         Args:
             nfa_start: Starting state of the NFA
-            alphabet: Input symbols (excluding epsilon)
+            alphabet: Input symbols (excluding epsilon), every byte by default
             all_nfa_states: All states in the NFA
         """
         self.nfa_start = nfa.start
-        self.alphabet = alphabet
         self.all_nfa_states = nfa.states
+        # the symbols of the DFA are byte ranges, see _partition
+        self.alphabet = self._partition(alphabet)
+        self._alphabet_lows = [low for low, _ in self.alphabet]
 
         # DFA components
         self.dfa_states: Set[FrozenSet[NFAState]] = set()
@@ -153,7 +171,7 @@ class DFAConverter:
         # table to keep track of the transitions
         # using NFA.char_transitions adds ambiguity
         self.transitions: Dict[
-            Tuple[FrozenSet[NFAState], str], FrozenSet[NFAState]
+            Tuple[FrozenSet[NFAState], ByteRange], FrozenSet[NFAState]
         ] = {}
 
         # Track token types for states with multiple accept states
@@ -175,12 +193,60 @@ class DFAConverter:
                     stack.append(neighbor)
         return frozenset(closure)
 
-    def _move(self, states: Set[NFAState], symbol: Condition) -> Set[NFAState]:
+    def _partition(self, alphabet: Optional[Set[str]]) -> List[ByteRange]:
+        """
+        Cut the bytes into the fewest disjoint ranges that every NFA range
+        either covers or misses, so that one range is one symbol: a
+        [^"] is a handful of symbols, not 255 of them.
+
+        '\0' is always a symbol of its own (the generated code tells it
+        apart from the end of the input).
+        """
+        ranges: Ranges = []
+        seen = {self.nfa_start}
+        stack = [self.nfa_start]
+        while stack:
+            state = stack.pop()
+            ranges += state.char_transitions
+            targets = set(state.epsilon_transitions)
+            for group in state.char_transitions.values():
+                targets |= group
+            for target in targets - seen:
+                seen.add(target)
+                stack.append(target)
+
+        allowed = merge_ranges(
+            [(ord(c), ord(c)) for c in alphabet] if alphabet is not None else [(0, 255)]
+        )
+        cuts = {0, 1, 256}
+        for low, high in ranges + allowed:
+            cuts |= {low, high + 1}
+        cuts = sorted(cut for cut in cuts if cut <= 256)
+
+        covered = merge_ranges(ranges)
+        inside = lambda low, high, spans: any(a <= low and high <= b for a, b in spans)
+        return [
+            (low, high - 1)
+            for low, high in zip(cuts, cuts[1:])
+            if inside(low, high - 1, covered) and inside(low, high - 1, allowed)
+        ]
+
+    def target(self, state: FrozenSet[NFAState], byte: int) -> Optional[FrozenSet[NFAState]]:
+        """Where state goes on byte, None for the dead state."""
+        index = bisect_right(self._alphabet_lows, byte) - 1
+        if index < 0 or byte > self.alphabet[index][1]:
+            return None
+        return self.transitions.get((state, self.alphabet[index]))
+
+    def _move(self, states: Set[NFAState], symbol: ByteRange) -> Set[NFAState]:
         """Compute move for a set of states under a symbol."""
+        low, high = symbol
         next_states = set()
         for state in states:
-            if symbol in state.char_transitions:
-                next_states |= state.char_transitions[symbol]
+            for (first, last), targets in state.char_transitions.items():
+                # symbols never straddle a range
+                if first <= low and high <= last:
+                    next_states |= targets
         return next_states
 
     def convert(self) -> None:
@@ -257,6 +323,81 @@ class DFAConverter:
             if k[0] in reachable and v in reachable
         }
 
+    def minimize(self) -> None:
+        """
+        Merge equivalent states (Hopcroft's partition refinement).
+
+        The first partition groups states by the token they accept, which
+        already went through pattern_index, so two states only merge when
+        they accept the same token after every possible suffix.
+        A missing transition goes to an implicit dead state; states that
+        end up equivalent to it are dropped.
+        """
+        before = len(self.dfa_states)
+        dead = None
+        states = list(self.dfa_states) + [dead]
+
+        # who gets to target on symbol
+        inverse: Dict[Tuple[ByteRange, Optional[FrozenSet[NFAState]]], Set] = defaultdict(set)
+        for state in self.dfa_states:
+            for symbol in self.alphabet:
+                target = self.transitions.get((state, symbol), dead)
+                inverse[(symbol, target)].add(state)
+        for symbol in self.alphabet:
+            inverse[(symbol, dead)].add(dead)
+
+        groups = defaultdict(set)
+        for state in states:
+            groups[self.token_types.get(state)].add(state)
+        partition = [frozenset(group) for group in groups.values()]
+        worklist = list(partition)
+
+        while worklist:
+            splitter = worklist.pop()
+            for symbol in self.alphabet:
+                sources = set()
+                for target in splitter:
+                    sources |= inverse.get((symbol, target), set())
+                if not sources:
+                    continue
+
+                refined = []
+                for block in partition:
+                    inside = block & sources
+                    if not inside or inside == block:
+                        refined.append(block)
+                        continue
+                    outside = block - inside
+                    refined += [inside, outside]
+                    if block in worklist:
+                        worklist.remove(block)
+                        worklist += [inside, outside]
+                    else:
+                        worklist.append(min(inside, outside, key=len))
+                partition = refined
+
+        representative = {}
+        for block in partition:
+            if dead in block:
+                continue
+            # keep the start state as the name of its block
+            rep = self.dfa_start if self.dfa_start in block else next(iter(block))
+            for state in block:
+                representative[state] = rep
+
+        self.transitions = {
+            (representative[state], symbol): representative[target]
+            for (state, symbol), target in self.transitions.items()
+            if state in representative and target in representative
+        }
+        self.dfa_start = representative[self.dfa_start]
+        self.dfa_states = set(representative.values())
+        self.dfa_accept = {s for s in self.dfa_accept if s in self.dfa_states}
+        self.token_types = {
+            s: token for s, token in self.token_types.items() if s in self.dfa_states
+        }
+        print(f"DFA minimization: {before} -> {len(self.dfa_states)} states")
+
     def get_dfa_components(
         self,
     ) -> Tuple[
@@ -286,33 +427,66 @@ class DFAConverter:
             token_type = self.token_types.get(state, "")
             is_accept = "Yes" if state in self.dfa_accept else "No"
 
-            trans = []
+            # neighbouring symbols to the same place read as one range
+            spans = []
             for symbol in self.alphabet:
-                if (state, symbol) in self.transitions:
-                    target = self.transitions[(state, symbol)]
-                    target_label = "{" + ",".join(str(s.id) for s in target) + "}"
-                    trans.append(f"{symbol}→{target_label}")
+                target = self.transitions.get((state, symbol))
+                if target is None:
+                    continue
+                if spans and spans[-1][2] == target and spans[-1][1] + 1 == symbol[0]:
+                    spans[-1] = (spans[-1][0], symbol[1], target)
+                else:
+                    spans.append((symbol[0], symbol[1], target))
+
+            trans = []
+            for low, high, target in spans:
+                target_label = "{" + ",".join(str(s.id) for s in target) + "}"
+                trans.append(f"{format_byte_range((low, high))}→{target_label}")
 
             print(
                 f"{state_label:<15} | {token_type:<6} | {is_accept:<6} | {', '.join(trans)}"
             )
 
 
+def format_byte_range(symbol: ByteRange) -> str:
+    """'a'-'z', 0x80-0xbf ..."""
+    low, high = symbol
+    show = lambda byte: repr(chr(byte)) if 32 < byte < 127 else f"0x{byte:02x}"
+    return show(low) if low == high else f"{show(low)}-{show(high)}"
+
+
+WORD_CHARS = frozenset(
+    "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_"
+)
+DIGIT_CHARS = frozenset("0123456789")
+BLANK_CHARS = frozenset(" \t\n\r")
+
+# self loops over these classes are skipped with the scanners in scan.h
+RUN_SCANNERS = {
+    WORD_CHARS: "scan_word",
+    DIGIT_CHARS: "scan_digits",
+    BLANK_CHARS: "scan_whitespace",
+}
+
+
 # the amalgamation of all (lexical) things
 class DFACCodeGenerator:
     """Generates optimized C code to simulate DFA behavior with token return."""
 
-    def __init__(self, converter, token_types: List[str]):
+    def __init__(self, converter, token_types: List[str], skipped: Set[str] = frozenset()):
         """
         Args:
             converter: DFAConverter instance with computed DFA
             token_types: Ordered list of token type names
+            skipped: Tokens matched and dropped (whitespace): the DFA goes
+                back to its start state after them instead of returning
         """
         self.converter = converter
         self.dfa_states = converter.dfa_states
         self.dfa_start = converter.dfa_start
         self.transitions = converter.transitions
         self.token_types = token_types
+        self.skipped = skipped
 
         # Map state sets to integer IDs
         self.state_to_id = {}
@@ -342,6 +516,70 @@ class DFACCodeGenerator:
                 self.accepting.append(0)
                 self.token_ids.append(-1)
 
+    def edges(self, state_set) -> List[Tuple[ByteRange, FrozenSet[NFAState]]]:
+        """The transitions out of state_set, by byte range."""
+        return [
+            (symbol, self.transitions[(state_set, symbol)])
+            for symbol in self.converter.alphabet
+            if (state_set, symbol) in self.transitions
+        ]
+
+    def skips(self, i: int) -> bool:
+        """Whether state i accepts a skipped token."""
+        return bool(self.accepting[i]) and self.token_types[self.token_ids[i]] in self.skipped
+
+    def skips_whole_run(self, i: int, state_set) -> bool:
+        """
+        Whether state i skips and nothing follows but more of the same,
+        which its scanner takes at once: the skip is over right there.
+        """
+        edges = self.edges(state_set)
+        return (
+            self.skips(i)
+            and all(target == state_set for _, target in edges)
+            and (not edges or self.run_scanner(state_set) is not None)
+            and self.nul_target(state_set) is None
+        )
+
+    def entry_scanner(self) -> Tuple[Optional[str], Optional[FrozenSet[NFAState]]]:
+        """
+        The scanner of a skipped run that leaves the start state on the
+        bytes it loops on (whitespace between tokens), and the state of
+        that run, if there is one. The scanner runs before the start
+        state, so such runs never go through the DFA. Not when something
+        loops back into the start state.
+        """
+        start = self.dfa_start
+        if any(target == start for target in self.transitions.values()):
+            return None, None
+        for i, state_set in enumerate(self.states_sorted):
+            scanner = self.run_scanner(state_set)
+            if scanner is None or not self.skips_whole_run(i, state_set):
+                continue
+            into = [symbol for symbol, target in self.edges(start) if target == state_set]
+            loop = [symbol for symbol, target in self.edges(state_set) if target == state_set]
+            if merge_ranges(into) == merge_ranges(loop):
+                return scanner, state_set
+        return None, None
+
+    def run_scanner(self, state_set) -> Optional[str]:
+        """Scanner for the bytes that keep state_set where it is, if any."""
+        loop = frozenset(
+            chr(c)
+            for (low, high), target in self.edges(state_set)
+            if target == state_set
+            for c in range(low, high + 1)
+        )
+        return RUN_SCANNERS.get(loop)
+
+    def nul_target(self, state_set):
+        """
+        Where '\0' leads from state_set, if anywhere ([^"] takes it).
+        The byte at end is a '\0' too, so this edge is only taken after
+        checking that the byte is still inside the input.
+        """
+        return self.converter.target(state_set, 0)
+
     def _c_escape_char(self, c: int) -> str:
         """Convert char code to escaped C character literal."""
         if c == ord("\\"):
@@ -360,25 +598,11 @@ class DFACCodeGenerator:
             return r"'\r'"
         if 32 <= c <= 126:  # Printable ASCII
             return f"'{chr(c)}'"
+        if c >= 128:
+            # '\x80' is negative where char is signed, c never is
+            return f"0x{c:02x}"
         return f"'\\x{c:02x}'"  # Hex escape for non-printables
 
-    def _get_ranges(self, chars: List[int]) -> List[Tuple[int, int]]:
-        """Convert sorted char codes to inclusive ranges."""
-        if not chars:
-            return []
-        sorted_chars = sorted(chars)
-        ranges = []
-        start = end = sorted_chars[0]
-
-        for c in sorted_chars[1:]:
-            if c == end + 1:
-                end = c
-            else:
-                ranges.append((start, end))
-                start = end = c
-        ranges.append((start, end))
-        return ranges
-
     def generate_header(self, h_file: Path) -> None:
         """Generate .h file with function declarations and token types."""
         with open(h_file / "regex_dfa.h", "w") as f:
@@ -395,9 +619,16 @@ class DFACCodeGenerator:
             f.write("} TokenType;\n\n")
 
             # Function declaration
-            f.write("// DFA matching function\n")
             f.write(
-                "const char* match_pattern(const char* input, TokenType* token_type);\n\n"
+                "// Longest match at *input, NULL (TOKEN_ERROR) when nothing matches.\n"
+                "// Skipped tokens (whitespace) are matched and passed over: *input\n"
+                "// is left where the token starts, at or past end when none does.\n"
+                "// The byte at end must be readable and end every token: a '\\0'\n"
+                "// for whole buffers, or where a token ends for slices of one.\n"
+                "// '\\0' bytes before end are input like any other.\n"
+            )
+            f.write(
+                "const char* match_pattern(const char** input, const char* end, TokenType* token_type);\n\n"
             )
             f.write("#endif // REGEX_DFA_H\n")
 
@@ -406,25 +637,59 @@ class DFACCodeGenerator:
         with open(c_file / "regex_dfa.c", "w") as f:
             # Include header and start function
             f.write(f'#include "regex_dfa.h"\n')
+            f.write(f'#include "scan.h"\n')
             f.write(f"#include <stdio.h>\n\n")
             f.write(
-                "const char* match_pattern(const char* input, TokenType* token_type) {\n"
+                "const char* match_pattern(const char** input, const char* end, TokenType* token_type) {\n"
             )
-            f.write("    const char* current = input;\n")
+            f.write("    const char* start = *input;\n")
+            f.write("    const char* current = start;\n")
             f.write("    const char* last_accept = NULL;\n")
             f.write("    TokenType last_token = TOKEN_ERROR;\n")
-            f.write("    char c;\n\n")
+            f.write("    unsigned char c;\n\n")
 
             # Start at initial state
             start_id = self.state_to_id[self.dfa_start]
+            entry_scanner, entry_run = self.entry_scanner()
             f.write(f"    goto STATE_{start_id};\n\n")
 
+            # whether some state leaves a skipped token in last_token for
+            # DEAD to skip (runs the scanners take whole never do)
+            skipped_at_dead = set()
+
             # Generate state handlers
             for i, state_set in enumerate(self.states_sorted):
+                # only the start state led there, before its scanner ran
+                # (its own loop is the scanner's, not a jump)
+                if state_set == entry_run and not any(
+                    target == entry_run and state not in (self.dfa_start, entry_run)
+                    for (state, _), target in self.transitions.items()
+                ):
+                    continue
                 f.write(f"STATE_{i}:\n")
 
+                # whitespace before the token
+                if i == start_id and entry_scanner:
+                    f.write(f"    current = {entry_scanner}(current);\n")
+                    f.write("    start = current;\n")
+
+                # identifier and number tails: the whole run at once
+                scanner = self.run_scanner(state_set)
+                if scanner:
+                    f.write(f"    current = {scanner}(current);\n")
+
+                # the longest match is a skipped token (a whitespace run):
+                # the next token starts here, from the start state
+                if self.skips_whole_run(i, state_set):
+                    f.write("    start = current;\n")
+                    f.write("    last_accept = NULL;\n")
+                    f.write(f"    goto STATE_{start_id};\n\n")
+                    continue
+
                 # Update last accept position
                 if self.accepting[i]:
+                    if self.skips(i):
+                        skipped_at_dead.add(self.token_types[self.token_ids[i]])
                     nam = self.token_types[self.token_ids[i]].upper()
                     #for state in state_set:
                     #    if state.is_accepting and (state.token_type != (self.token_types[self.token_ids[i]].upper())):
@@ -435,42 +700,27 @@ class DFACCodeGenerator:
                         #f"    last_token = TOKEN_{nam};\n"
                     )
 
-                # we could add another state for this
-                # but it would prefer not to add more jumps
-                # End of string handling
-                f.write("    if (*current == (char) '\\0') {\n")
-                f.write("        if (last_accept != NULL) {\n")
-                f.write("            *token_type = last_token;\n")
-                f.write("            return current;\n")
-                f.write("        }\n")
-                f.write("        *token_type = TOKEN_ERROR;\n")
-                f.write("        return current;\n")
-                f.write("    }\n")
-
                 f.write("    c = *current++;\n")
 
                 # Build transition map for current state
+                # ('\0' last: it has to be told apart from the end)
                 next_map = defaultdict(list)
-                for c_int in range(128):  # (traditional) ASCII
-                    char = chr(c_int)
-                    key = (state_set, char)
-                    if key in self.transitions:
-                        next_state = self.transitions[key]
-                        next_id = self.state_to_id[next_state]
-                        next_map[next_id].append(c_int)
+                for (low, high), next_state in self.edges(state_set):
+                    if i == start_id and next_state == entry_run:
+                        continue  # taken by the entry scanner
+                    if low > 0:  # bytes, UTF-8 past ASCII
+                        next_map[self.state_to_id[next_state]].append((low, high))
 
                 # Generate optimized condition checks
                 conditions_generated = False
-                for next_id, chars in next_map.items():
-                    ranges = self._get_ranges(chars)
+                for next_id, symbols in next_map.items():
+                    ranges = merge_ranges(symbols)
                     condition_parts = []
 
                     for start, end in ranges:
                         if start == end:
                             c_repr = self._c_escape_char(start)
-                            # char literals in C are ints
-                            # figures
-                            condition_parts.append(f"c == (char) {c_repr}")
+                            condition_parts.append(f"c == {c_repr}")
                         else:
                             start_repr = self._c_escape_char(start)
                             end_repr = self._c_escape_char(end)
@@ -484,6 +734,12 @@ class DFACCodeGenerator:
                     f.write(f"goto STATE_{next_id};\n")
                     conditions_generated = True
 
+                nul_target = self.nul_target(state_set)
+                if nul_target is not None:
+                    next_id = self.state_to_id[nul_target]
+                    f.write(f"    if (c == '\\0' && current <= end) goto STATE_{next_id};\n")
+                    conditions_generated = True
+
                 # Handle dead state transitions
                 if not conditions_generated:
                     f.write("    goto DEAD;\n")
@@ -494,9 +750,20 @@ class DFACCodeGenerator:
             # Dead state handler
             f.write("DEAD:\n")
             f.write("    if (last_accept != NULL) {\n")
+            if skipped_at_dead:
+                skipped = " || ".join(
+                    f"last_token == TOKEN_{token.upper()}" for token in sorted(skipped_at_dead)
+                )
+                f.write(f"        if ({skipped}) {{\n")
+                f.write("            start = current = last_accept;\n")
+                f.write("            last_accept = NULL;\n")
+                f.write(f"            goto STATE_{start_id};\n")
+                f.write("        }\n")
+            f.write("        *input = start;\n")
             f.write("        *token_type = last_token;\n")
             f.write("        return last_accept;\n")
             f.write("    }\n")
+            f.write("    *input = start;\n")
             f.write("    return NULL;\n")
             f.write("}\n")
 
@@ -506,6 +773,203 @@ class DFACCodeGenerator:
         self.generate_source(Path(output_dir))
 
 
+class DFATableCodeGenerator(DFACCodeGenerator):
+    """
+    Same DFA, emitted as data: bytes are folded into equivalence classes
+    (bytes every state treats the same way share a column) and
+    match_pattern is one loop over a state x class table.
+    The goto backend grows a label and a chain of ifs per state instead.
+    """
+
+    DEAD = 0
+
+    def _table_ids(self) -> Dict[FrozenSet[NFAState], int]:
+        # 0 is the dead state, it never leaves
+        return {state_set: i + 1 for i, state_set in enumerate(self.states_sorted)}
+
+    def byte_classes(self) -> Tuple[List[int], List[Tuple[int, ...]]]:
+        """Map every byte to a class; returns (class of byte, column of class)."""
+        table_ids = self._table_ids()
+        dead_column = tuple(self.DEAD for _ in self.states_sorted)
+        columns = {dead_column: 0}
+        byte_class = [0] * 256
+        for low, high in self.converter.alphabet:
+            # '\0' goes through nul_state, after the check for the end
+            if low == 0:
+                continue
+            column = tuple(
+                table_ids.get(self.transitions.get((state_set, (low, high))), self.DEAD)
+                for state_set in self.states_sorted
+            )
+            if column not in columns:
+                columns[column] = len(columns)
+            byte_class[low : high + 1] = [columns[column]] * (high - low + 1)
+        return byte_class, list(columns)
+
+    def _write_array(self, f, rows: List[List[int]], indent: str = "    ") -> None:
+        for row in rows:
+            for start in range(0, len(row), 16):
+                chunk = ", ".join(str(v) for v in row[start : start + 16])
+                f.write(f"{indent}{chunk},\n")
+
+    def generate_source(self, c_file: Path) -> None:
+        """Generate .c file with the tables and the scanning loop."""
+        table_ids = self._table_ids()
+        byte_class, columns = self.byte_classes()
+        state_count = len(self.states_sorted) + 1
+        class_count = len(columns)
+        state_type = "uint8_t" if state_count <= 256 else "uint16_t"
+
+        with open(c_file / "regex_dfa.c", "w") as f:
+            f.write('#include "regex_dfa.h"\n')
+            f.write('#include "scan.h"\n')
+            f.write("#include <stddef.h>\n")
+            f.write("#include <stdint.h>\n\n")
+            f.write(f"// {state_count} states, {class_count} byte classes\n")
+            f.write(f"#define START_STATE {table_ids[self.dfa_start]}\n")
+            f.write(f"#define CLASS_COUNT {class_count}\n\n")
+
+            f.write("static const uint8_t byte_class[256] = {\n")
+            self._write_array(f, [byte_class])
+            f.write("};\n\n")
+
+            f.write(f"static const {state_type} next_state[{state_count}][CLASS_COUNT] = {{\n")
+            for state in range(state_count):
+                row = [column[state - 1] if state else self.DEAD for column in columns]
+                f.write("    {\n")
+                self._write_array(f, [row], indent="        ")
+                f.write("    },\n")
+            f.write("};\n\n")
+
+            # token + 1, 0 when the state does not accept
+            accept = [0] + [
+                self.token_ids[i] + 1 if self.accepting[i] else 0
+                for i in range(len(self.states_sorted))
+            ]
+            f.write(f"static const uint8_t accept_token[{state_count}] = {{\n")
+            self._write_array(f, [accept])
+            f.write("};\n\n")
+
+            # where '\0' leads when it is not the byte at end
+            nul_state = [0] + [
+                table_ids.get(self.nul_target(state_set), self.DEAD)
+                for state_set in self.states_sorted
+            ]
+            f.write(f"static const {state_type} nul_state[{state_count}] = {{\n")
+            self._write_array(f, [nul_state])
+            f.write("};\n\n")
+
+            # identifier and number tails: the whole run at once
+            scanners = [self.run_scanner(state_set) for state_set in self.states_sorted]
+            f.write(f"static const char* (*const run_scanner[{state_count}])(const char*) = {{\n")
+            for i, scanner in enumerate(scanners):
+                if scanner:
+                    f.write(f"    [{i + 1}] = {scanner},\n")
+            f.write("};\n\n")
+
+            # token + 1 as in accept_token
+            skipped = " || ".join(
+                f"(token) == {self.token_types.index(token) + 1}" for token in sorted(self.skipped)
+            )
+            f.write(f"// skipped tokens (whitespace)\n#define SKIPPED(token) ({skipped or '0'})\n")
+            # whitespace before the token, see entry_scanner
+            entry_scanner, _ = self.entry_scanner()
+            entry = f"(const unsigned char*) {entry_scanner}((const char*) start)" if entry_scanner else "start"
+            f.write(f"#define ENTRY(start) ({entry})\n\n")
+
+            f.write(
+                "// the slow way, for the rare '\\0' inside the input (in a string)\n"
+                "__attribute__((noinline, cold)) static const char* match_with_nul(const char** input, const char* end, TokenType* token_type) {\n"
+                "    const unsigned char* start = (const unsigned char*) *input;\n"
+                "    const unsigned char* current;\n"
+                "    const unsigned char* last_accept;\n"
+                "    unsigned int last_token;\n"
+                "\n"
+                "    for (;;) {\n"
+                "        unsigned int state = START_STATE;\n"
+                "        current = start;\n"
+                "        last_accept = NULL;\n"
+                "        last_token = 0;\n"
+                "        while (state != 0) {\n"
+                "            if (accept_token[state]) {\n"
+                "                last_accept = current;\n"
+                "                last_token = accept_token[state];\n"
+                "            }\n"
+                "            unsigned char c = *current++;\n"
+                "            if (c == '\\0') {\n"
+                "                state = (current <= (const unsigned char*) end) ? nul_state[state] : 0;\n"
+                "            }\n"
+                "            else {\n"
+                "                state = next_state[state][byte_class[c]];\n"
+                "            }\n"
+                "        }\n"
+                "        if (last_accept == NULL || !SKIPPED(last_token)) {\n"
+                "            break;\n"
+                "        }\n"
+                "        start = last_accept;\n"
+                "    }\n"
+                "\n"
+                "    *input = (const char*) start;\n"
+                "    if (last_accept == NULL) {\n"
+                "        *token_type = TOKEN_ERROR;\n"
+                "        return NULL;\n"
+                "    }\n"
+                "    *token_type = (TokenType) (last_token - 1);\n"
+                "    return (const char*) last_accept;\n"
+                "}\n"
+                "\n"
+                "const char* match_pattern(const char** input, const char* end, TokenType* token_type) {\n"
+                "    const unsigned char* start = (const unsigned char*) *input;\n"
+                "    const unsigned char* current;\n"
+                "    const unsigned char* last_accept;\n"
+                "    unsigned int last_token;\n"
+                "\n"
+                "    for (;;) {\n"
+                "        unsigned int state = START_STATE;\n"
+                "        start = ENTRY(start);\n"
+                "        current = start;\n"
+                "        last_accept = NULL;\n"
+                "        last_token = 0;\n"
+                "        // the dead state (and '\\0', in the dead class) ends the loop\n"
+                "        while (state != 0) {\n"
+                "            if (run_scanner[state]) {\n"
+                "                current = (const unsigned char*) run_scanner[state]((const char*) current);\n"
+                "            }\n"
+                "            if (accept_token[state]) {\n"
+                "                last_accept = current;\n"
+                "                last_token = accept_token[state];\n"
+                "            }\n"
+                "            state = next_state[state][byte_class[*current++]];\n"
+                "        }\n"
+                "        // once per token: a '\\0' before end may not end it\n"
+                "        if (current[-1] == '\\0' && current <= (const unsigned char*) end) {\n"
+                "            *input = (const char*) start;\n"
+                "            return match_with_nul(input, end, token_type);\n"
+                "        }\n"
+                "        // a skipped token: the next one starts where it ended\n"
+                "        if (last_accept == NULL || !SKIPPED(last_token)) {\n"
+                "            break;\n"
+                "        }\n"
+                "        start = last_accept;\n"
+                "    }\n"
+                "\n"
+                "    *input = (const char*) start;\n"
+                "    if (last_accept == NULL) {\n"
+                "        *token_type = TOKEN_ERROR;\n"
+                "        return NULL;\n"
+                "    }\n"
+                "    *token_type = (TokenType) (last_token - 1);\n"
+                "    return (const char*) last_accept;\n"
+                "}\n"
+            )
+
+
+DFA_BACKENDS = {
+    "goto": DFACCodeGenerator,
+    "table": DFATableCodeGenerator,
+}
+
+
 def create_nfa_for_pattern() -> Tuple[NFAState, Set[NFAState]]:
     """Create NFA for regex pattern: a(b|c)*"""
     # Create states
@@ -514,10 +978,9 @@ def create_nfa_for_pattern() -> Tuple[NFAState, Set[NFAState]]:
     q2 = NFAState(2, is_accepting=True, token_type="FINAL")
 
     # Add transitions
-    q0.char_transitions["a"] = {q1}
+    q0.char_transitions[(ord("a"), ord("a"))] = {q1}
     q1.epsilon_transitions = {q2}
-    q2.char_transitions["b"] = {q2}
-    q2.char_transitions["c"] = {q2}
+    q2.char_transitions[(ord("b"), ord("c"))] = {q2}
 
     nfa = NFA(start=q0, end=q2)
 
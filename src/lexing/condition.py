@@ -1,7 +1,88 @@
-from typing import Set
+from typing import List, Set, Tuple
 
 ASCII_SET = {chr(i) for i in range(128)}
 
+MAX_CODE_POINT = 0x10FFFF
+SURROGATES = (0xD800, 0xDFFF)
+
+Ranges = List[Tuple[int, int]]
+
+
+def to_bytes(text: str) -> str:
+    """text as the automata see it: one symbol per UTF-8 byte."""
+    return text.encode("utf-8").decode("latin-1")
+
+
+def from_bytes(symbols: str) -> str:
+    """Inverse of to_bytes."""
+    return symbols.encode("latin-1").decode("utf-8")
+
+
+def merge_ranges(ranges: Ranges) -> Ranges:
+    """Sorted, with overlapping and adjacent ranges joined."""
+    merged: Ranges = []
+    for low, high in sorted(ranges):
+        if merged and low <= merged[-1][1] + 1:
+            merged[-1] = (merged[-1][0], max(merged[-1][1], high))
+        else:
+            merged.append((low, high))
+    return merged
+
+
+def complement(ranges: Ranges) -> Ranges:
+    """Every code point outside ranges."""
+    result: Ranges = []
+    next_low = 0
+    for low, high in merge_ranges(ranges):
+        if low > next_low:
+            result.append((next_low, low - 1))
+        next_low = high + 1
+    if next_low <= MAX_CODE_POINT:
+        result.append((next_low, MAX_CODE_POINT))
+    return result
+
+
+def utf8_sequences(low: int, high: int) -> List[Ranges]:
+    """
+    Byte range sequences matching exactly the UTF-8 encodings of the
+    code points low..high (surrogates have none).
+
+    A range is cut where the encoded length changes, then where the
+    continuation bytes would not cover 0x80..0xBF, until every piece
+    is a plain product of byte ranges:
+
+        U+0080..U+07FF  ->  [C2-DF][80-BF]
+    """
+    sequences: List[Ranges] = []
+    pending = [(low, high)]
+    while pending:
+        low, high = pending.pop()
+        if low > high:
+            continue
+        if low <= SURROGATES[1] and high >= SURROGATES[0]:
+            pending += [(low, SURROGATES[0] - 1), (SURROGATES[1] + 1, high)]
+            continue
+        cut = next((top for top in (0x7F, 0x7FF, 0xFFFF) if low <= top < high), None)
+        if cut is not None:
+            pending += [(low, cut), (cut + 1, high)]
+            continue
+        if high <= 0x7F:
+            sequences.append([(low, high)])
+            continue
+        for tail in range(1, len(chr(low).encode("utf-8"))):
+            mask = (1 << (6 * tail)) - 1
+            if low & ~mask != high & ~mask:
+                if low & mask != 0:
+                    pending += [(low, low | mask), ((low | mask) + 1, high)]
+                    break
+                if high & mask != mask:
+                    pending += [(low, (high & ~mask) - 1), (high & ~mask, high)]
+                    break
+        else:
+            first, last = chr(low).encode("utf-8"), chr(high).encode("utf-8")
+            sequences.append(list(zip(first, last)))
+    return sorted(sequences)
+
 
 class Condition:
     """Base class for character matching conditions."""
@@ -12,6 +93,18 @@ class Condition:
     def expand(self) -> list:
         raise NotImplementedError
 
+    def ranges(self) -> Ranges:
+        """The code points matched; ASCII ones are what expand() gives."""
+        return merge_ranges([(ord(c), ord(c)) for c in self.expand()])
+
+    def byte_sequences(self) -> List[Ranges]:
+        """The UTF-8 encodings of ranges(), as byte range sequences."""
+        return [
+            sequence
+            for low, high in self.ranges()
+            for sequence in utf8_sequences(low, high)
+        ]
+
     def __repr__(self):
         return self.__str__()
 
@@ -41,6 +134,11 @@ class CharSetCondition(Condition):
             return self.chars
         return ASCII_SET.difference(self.chars)
 
+    def ranges(self):
+        own = merge_ranges([(ord(c), ord(c)) for c in self.chars])
+        # [^"] takes any code point but '"', not just any ASCII one
+        return complement(own) if self.negate else own
+
     def __str__(self):
         return f"[{'^' if self.negate else ''}{''.join(sorted(self.chars))}]"
 
@@ -54,6 +152,9 @@ class WildcardCondition(Condition):
     def expand(self):
         return ASCII_SET.difference({"\n"})
 
+    def ranges(self):
+        return complement([(ord("\n"), ord("\n"))])
+
     def __str__(self):
         return "."
 
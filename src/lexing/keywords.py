@@ -0,0 +1,149 @@
+from dataclasses import dataclass
+from typing import Dict, List, Optional, Tuple
+
+from lexing.regex import RegexEngine
+
+
+WORD_START = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_"
+WORD = WORD_START + "0123456789"
+
+
+@dataclass
+class Keyword:
+    token: str
+    text: str
+    # the rule that lexes the keyword when it is not in the DFA
+    host: str
+
+
+def split_keywords(
+    rules: List[Tuple[str, str]], engine: RegexEngine
+) -> Tuple[List[Tuple[str, str]], List[Keyword]]:
+    """
+    Take the keyword rules out of rules.
+
+    A keyword is a rule whose pattern is a plain word, such that the first
+    other rule matching that word is a later, non keyword one (its host).
+    Without the keyword the DFA lexes the same span as the host, so
+    relabelling host tokens with that text gives the same token stream.
+    """
+    literal = {
+        index
+        for index, (_, pattern) in enumerate(rules)
+        if pattern and pattern[0] in WORD_START and all(c in WORD for c in pattern)
+    }
+
+    keywords = []
+    for index in sorted(literal):
+        token, text = rules[index]
+        host = next(
+            (
+                other
+                for other, (_, pattern) in enumerate(rules)
+                if other != index and engine.match(pattern, text)
+            ),
+            None,
+        )
+        if host is not None and host > index and host not in literal:
+            keywords.append(Keyword(token, text, rules[host][0]))
+
+    taken = {keyword.token for keyword in keywords}
+    rest = [rule for rule in rules if rule[0] not in taken]
+    return rest, keywords
+
+
+def perfect_hash(words: List[str]) -> Optional[Tuple[int, int, int]]:
+    """
+    (a, b, size) with
+
+        (first * a ^ last * b ^ length) & (size - 1)
+
+    different for every word, trying the smallest tables first.
+    None when first, last and length do not tell two words apart.
+    """
+    keys = {(ord(word[0]), ord(word[-1]), len(word)) for word in words}
+    if len(keys) != len(words):
+        return None
+
+    size = 1
+    while size < len(words):
+        size *= 2
+    while size <= 16 * max(len(words), 1):
+        for a in range(1, 256):
+            for b in range(1, 256):
+                slots = {(f * a ^ l * b ^ n) & (size - 1) for f, l, n in keys}
+                if len(slots) == len(keys):
+                    return a, b, size
+        size *= 2
+    return None
+
+
+def generate_keyword_table(keywords: List[Keyword]) -> str:
+    """C for classify_keyword(), which relabels host tokens spelling a keyword."""
+    if not keywords:
+        lines = [
+            "static inline TokenType classify_keyword(const char* text, int length, TokenType tt) {",
+            "    (void) text;",
+            "    (void) length;",
+            "    return tt;",
+            "}",
+        ]
+        return "\n".join(lines) + "\n"
+
+    found = perfect_hash([keyword.text for keyword in keywords])
+    if found is None:
+        raise ValueError(
+            "keywords: no perfect hash over the first byte, last byte and length of "
+            + ", ".join(keyword.text for keyword in keywords)
+        )
+    a, b, size = found
+
+    slots: Dict[int, Keyword] = {}
+    for keyword in keywords:
+        text = keyword.text
+        slots[(ord(text[0]) * a ^ ord(text[-1]) * b ^ len(text)) & (size - 1)] = keyword
+
+    lengths = [len(keyword.text) for keyword in keywords]
+    lines = [
+        f"// {len(keywords)} keywords, lexed by the rule that also matches them",
+        "typedef struct {",
+        "    const char* text;",
+        "    int length; // 0 for an empty slot",
+        "    unsigned char first;",
+        "    unsigned char last;",
+        "    TokenType host;",
+        "    TokenType token;",
+        "} Keyword;",
+        "",
+        f"static const Keyword keywords[{size}] = {{",
+    ]
+    for slot in sorted(slots):
+        keyword = slots[slot]
+        lines.append(
+            f'    [{slot}] = {{"{keyword.text}", {len(keyword.text)}, '
+            f"'{keyword.text[0]}', '{keyword.text[-1]}', "
+            f"TOKEN_{keyword.host.upper()}, TOKEN_{keyword.token.upper()}}},"
+        )
+    lines += [
+        "};",
+        "",
+        "static inline TokenType classify_keyword(const char* text, int length, TokenType tt) {",
+        f"    if (length < {min(lengths)} || length > {max(lengths)}) {{",
+        "        return tt;",
+        "    }",
+        "    unsigned char first = text[0];",
+        "    unsigned char last = text[length - 1];",
+        f"    const Keyword* keyword = &keywords[(first * {a} ^ last * {b} ^ length) & {size - 1}];",
+        "    // one branch for the usual identifier that is not a keyword",
+        "    if ((keyword->host != tt) | (keyword->length != length) | (keyword->first != first) | (keyword->last != last)) {",
+        "        return tt;",
+        "    }",
+        "    for (int i = 1; i < length - 1; i++) {",
+        "        if (keyword->text[i] != text[i]) {",
+        "            return tt;",
+        "        }",
+        "    }",
+        "    return keyword->token;",
+        "}",
+    ]
+    return "\n".join(lines) + "\n"
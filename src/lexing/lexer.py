@@ -7,9 +7,16 @@ import re
 from collections import defaultdict
 from textwrap import dedent
 
-from lexing.condition import SingleCharCondition, MetaCharCondition
+from lexing.condition import (
+    SingleCharCondition,
+    MetaCharCondition,
+    to_bytes,
+    from_bytes,
+    utf8_sequences,
+)
 from lexing.regex import RegexEngine
-from lexing.automata import NFA, NFAState, DFAConverter, DFACCodeGenerator
+from lexing.automata import NFA, NFAState, DFAConverter, DFA_BACKENDS
+from lexing.keywords import split_keywords, perfect_hash, generate_keyword_table
 
 BASE_DIR = Path(__file__).parent
 
@@ -31,8 +38,10 @@ class Token:
 class Lexer:
     """Lexer generator with regex-based tokenization and position tracking."""
 
-    def __init__(self, rules: List[Tuple[str, str]], skip_whitespace: bool = True):
-        self.rules = rules
+    def __init__(self, rules: List[Tuple[str, ...]], skip_whitespace: bool = True):
+        # ("NAME", pattern, "skip") is matched, then dropped (whitespace)
+        self.skipped = {rule[0] for rule in rules if rule[2:] == ("skip",)}
+        self.rules = [(rule[0], rule[1]) for rule in rules]
         self.skip_whitespace = skip_whitespace
         self.engine = RegexEngine()
         self.combined_nfa = self._build_combined_nfa()
@@ -40,14 +49,14 @@ class Lexer:
         self.column = 1
         self.cache: Dict[int, Tuple] = {}  # Cache token matches by position
 
-    def _build_combined_nfa(self) -> NFA:
+    def _build_combined_nfa(self, rules=None) -> NFA:
         """Combine all rule NFAs into a single NFA with priorities."""
         start = NFAState(0)
         nfa = NFA(start, start)
         nfa.add_state(start)
 
         # Build NFAs for each pattern and connect to start
-        for idx, (token_type, pattern) in enumerate(self.rules):
+        for idx, (token_type, pattern) in enumerate(rules or self.rules):
             pattern_nfa = self.engine.compile(pattern)
             pattern_nfa.end.is_accepting = True
             pattern_nfa.end.token_type = token_type
@@ -64,6 +73,8 @@ class Lexer:
         """Convert input text into tokens with position tracking."""
         tokens = []
         index = 0
+        # the automata step over UTF-8 bytes
+        text = to_bytes(text)
         length = len(text)
 
         while index < length:
@@ -87,7 +98,9 @@ class Lexer:
 
             # Create token and update position
             token_type, token_value, token_length = token
-            tokens.append(Token(token_type, token_value, self.line, self.column))
+            token_value = from_bytes(token_value)
+            if token_type not in self.skipped:
+                tokens.append(Token(token_type, token_value, self.line, self.column))
             self._update_pos(token_value)
             index += token_length
 
@@ -146,25 +159,35 @@ class Lexer:
             self.line += len(lines) - 1
             self.column = len(lines[-1]) + 1  # +1 for next position
 
-    def generate_c_lexer(self, output_dir: str):
+    def generate_c_lexer(self, output_dir: str, backend: str = "goto"):
         """
         Generate C lexer (lexer.h and lexer.c) from Python lexer rules
         Handles regex patterns, position tracking, and prioritized rules
+
+        backend picks how the DFA is emitted (see DFA_BACKENDS):
+        "goto" for a label per state, "table" for a transition table
         """
         output_dir = Path(output_dir)
         os.makedirs(output_dir, exist_ok=True)
 
-        ascii_set = {chr(i) for i in range(128)}
-        converter = DFAConverter(self.combined_nfa, ascii_set)
+        # keywords are looked up once the DFA has lexed them as identifiers
+        rules, self.keywords = split_keywords(self.rules, self.engine)
+        print(
+            f"Keywords out of the DFA: {', '.join(k.text for k in self.keywords) or 'none'}"
+        )
+
+        converter = DFAConverter(self._build_combined_nfa(rules))
         converter.convert()
+        converter.minimize()
         converter.display_transition_table()
 
         # ordered
         tokens = list(dict(self.rules).keys())
 
-        generator = DFACCodeGenerator(
+        generator = DFA_BACKENDS[backend](
             converter,
             tokens,
+            self.skipped,
         )
         generator.generate_code(output_dir)
 
@@ -189,6 +212,7 @@ class Lexer:
         rule_types = []
 
         return dedent(lexer_template).format(
+            keyword_table=generate_keyword_table(self.keywords),
             rule_functions="\n\n".join(rule_functions),
             rule_func_ptrs=", ".join([f"rule{i}" for i in range(len(self.rules))]),
             rule_type_list=", ".join(rule_types),
@@ -285,6 +309,96 @@ def run_tests():
     converter = DFAConverter(lexer.combined_nfa, ascii_set)
     converter.convert()
     converter.display_transition_table()
+
+    # Minimization: "ab" and "cb" share their tail, keywords keep theirs
+    def longest_match(converter, text):
+        state, best = converter.dfa_start, None
+        for index, char in enumerate(text):
+            state = converter.target(state, ord(char))
+            if state is None:
+                break
+            if state in converter.token_types:
+                best = (converter.token_types[state], index + 1)
+        return best
+
+    rules = [("AB", r"ab|cb"), ("IF", r"if"), ("ID", r"[a-z]+"), ("INT", r"\d+")]
+    samples = ["ab", "cb", "if", "iff", "abc", "cbx", "i", "x", "42", "4a", ""]
+    minimized = DFAConverter(Lexer(rules).combined_nfa, ascii_set)
+    minimized.convert()
+    expected = [longest_match(minimized, sample) for sample in samples]
+    before = len(minimized.dfa_states)
+    minimized.minimize()
+    assert len(minimized.dfa_states) < before
+    assert [longest_match(minimized, sample) for sample in samples] == expected
+    assert longest_match(minimized, "iff") == ("ID", 3)
+    assert longest_match(minimized, "if") == ("IF", 2)
+
+    # Byte classes: digits, 'i', 'f', the other letters, '.' ...
+    table = DFA_BACKENDS["table"](converter, ["FLOAT", "INT", "IF"])
+    byte_class, columns = table.byte_classes()
+    assert byte_class[0] == 0 and byte_class[200] == 0
+    assert byte_class[ord("1")] == byte_class[ord("9")]
+    assert byte_class[ord("i")] != byte_class[ord("f")]
+    assert byte_class[ord("a")] == 0
+    assert len(columns) == 5
+
+    # Symbols are byte ranges: [^"] is a few of them, '\0' is its own
+    quoted = DFAConverter(Lexer([("S", r'"[^"]*"')]).combined_nfa)
+    assert quoted.alphabet[:3] == [(0, 0), (1, ord('"') - 1), (ord('"'), ord('"'))]
+    assert len(quoted.alphabet) < 16
+    quoted.convert()
+    assert quoted.target(quoted.dfa_start, ord('"')) is not None
+    assert quoted.target(quoted.dfa_start, ord("a")) is None
+
+    # UTF-8: code points past ASCII are byte sequences
+    assert utf8_sequences(0x80, 0x7FF) == [[(0xC2, 0xDF), (0x80, 0xBF)]]
+    assert utf8_sequences(0xD7FF, 0xE000) == [
+        [(0xED, 0xED), (0x9F, 0x9F), (0xBF, 0xBF)],
+        [(0xEE, 0xEE), (0x80, 0x80), (0x80, 0x80)],
+    ]
+    sequences = utf8_sequences(0x3B1, 0x1F600)
+    for code in [0x3B0, 0x3B1, 0x7FF, 0x800, 0xFFFF, 0x10000, 0x1F600, 0x1F601]:
+        encoded = chr(code).encode("utf-8")
+        covered = [
+            sequence
+            for sequence in sequences
+            if len(sequence) == len(encoded)
+            and all(low <= byte <= high for byte, (low, high) in zip(encoded, sequence))
+        ]
+        assert len(covered) == (1 if 0x3B1 <= code <= 0x1F600 else 0)
+
+    strings = Lexer([("STRING", r'"[^"]*"'), ("ID", r"[a-z]+")])
+    tokens = strings.tokenize('"héllo ✓ 😀" abc')
+    assert [(t.type, t.value) for t in tokens] == [("STRING", '"héllo ✓ 😀"'), ("ID", "abc")]
+    utf8 = DFAConverter(strings._build_combined_nfa())
+    utf8.convert()
+    utf8.minimize()
+    assert longest_match(utf8, to_bytes('"ü"')) == ("STRING", 4)
+    # a lone continuation byte, a truncated sequence, a surrogate
+    for invalid in [b'"\x80"', b'"\xc3"', b'"\xed\xa0\x80"']:
+        assert longest_match(utf8, invalid.decode("latin-1")) is None
+    assert engine.match(r"[^a]", "é") and not engine.match(r"[^a]", "a")
+
+    # Keywords: out of the DFA when a later rule lexes them
+    rules = [
+        ("IF", r"if"),
+        ("INT", r"\d+"),
+        ("IN", r"in"),
+        ("ID", r"[a-z]+"),
+        ("THEN", r"then"),
+    ]
+    rest, keywords = split_keywords(rules, engine)
+    assert [(k.token, k.text, k.host) for k in keywords] == [
+        ("IF", "if", "ID"),
+        ("IN", "in", "ID"),
+    ]
+    # THEN loses to ID, so it has to stay where it is
+    assert rest == [("INT", r"\d+"), ("ID", r"[a-z]+"), ("THEN", r"then")]
+    words = ["new", "type", "inherits", "if", "else", "in", "let", "while"]
+    a, b, size = perfect_hash(words)
+    slots = {(ord(w[0]) * a ^ ord(w[-1]) * b ^ len(w)) & (size - 1) for w in words}
+    assert len(slots) == len(words) and size & (size - 1) == 0
+    assert perfect_hash(["ab", "ab"]) is None
     print("All tests passed!")
 
 
@@ -6,6 +6,7 @@ from lexing.condition import (
     CharSetCondition,
     WildcardCondition,
     MetaCharCondition,
+    to_bytes,
 )
 from lexing.automata import NFA, NFAState
 
@@ -174,6 +175,8 @@ class RegexParser:
                         # Expand metacharacters in class
                         meta_set = MetaCharCondition(esc_char).sets[esc_char]
                         chars |= meta_set
+                    elif esc_char in "ntr":
+                        chars.add({"n": "\n", "t": "\t", "r": "\r"}[esc_char])
                     else:
                         chars.add(esc_char)
             elif i + 2 < len(token) and token[i + 1] == "-":
@@ -208,7 +211,7 @@ class RegexEngine:
         # walk the clausure in parallel
         current_states = self._epsilon_closure({nfa.start})
 
-        for char in text:
+        for char in to_bytes(text):
             current_states = self._epsilon_closure(self._step(current_states, char))
             # The automaton halted
             if not current_states:
@@ -220,8 +223,8 @@ class RegexEngine:
         """Move NFA states forward by consuming a character."""
         next_states = set()
         for state in states:
-            for condition, targets in state.char_transitions.items():
-                if condition == char:
+            for (low, high), targets in state.char_transitions.items():
+                if low <= ord(char) <= high:
                     next_states |= targets
         return next_states
 
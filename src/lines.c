@@ -0,0 +1,92 @@
+#include "lines.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#define TAB_WIDTH 4
+
+static _Thread_local LineIndex* current = NULL;
+
+void line_index_init(LineIndex* index, const char* source, size_t length) {
+    index->source = source;
+    index->length = length;
+    index->starts = NULL;
+    index->count = 0;
+    pthread_mutex_init(&index->lock, NULL);
+}
+
+void line_index_release(LineIndex* index) {
+    pthread_mutex_destroy(&index->lock);
+    free(index->starts);
+    index->starts = NULL;
+    index->count = 0;
+}
+
+// '\r' starts a line as well as '\n', like the lexer counted them when
+// tokens had lines of their own (so "\r\n" is two)
+static inline bool is_line_break(char c) {
+    return c == '\n' || c == '\r';
+}
+
+static void build(LineIndex* index) {
+    // count first (this loop vectorizes), then fill an array of that size
+    const char* source = index->source;
+    size_t length = index->length;
+    size_t count = 1;
+    for (size_t i = 0; i < length; i++) {
+        count += is_line_break(source[i]);
+    }
+
+    index->starts = malloc(count * sizeof(unsigned int));
+    if (index->starts == NULL) {
+        abort();
+    }
+    index->starts[0] = 0;
+    index->count = 1;
+    for (size_t i = 0; i < length; i++) {
+        if (is_line_break(source[i])) {
+            index->starts[index->count++] = i + 1;
+        }
+    }
+}
+
+SourcePosition line_index_lookup(LineIndex* index, unsigned int offset) {
+    pthread_mutex_lock(&index->lock);
+    if (index->starts == NULL) {
+        build(index);
+    }
+    pthread_mutex_unlock(&index->lock);
+    if (offset > index->length) {
+        offset = index->length;
+    }
+
+    // last line starting at or before offset
+    size_t low = 0;
+    size_t high = index->count;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (index->starts[middle] <= offset) {
+            low = middle;
+        }
+        else {
+            high = middle;
+        }
+    }
+
+    int column = 1;
+    for (unsigned int i = index->starts[low]; i < offset; i++) {
+        column += (index->source[i] == '\t') ? TAB_WIDTH - (column % TAB_WIDTH) : 1;
+    }
+    return (SourcePosition) {(int) low + 1, column};
+}
+
+void line_index_set_current(LineIndex* index) {
+    current = index;
+}
+
+SourcePosition source_position(unsigned int offset) {
+    if (current == NULL) {
+        return (SourcePosition) {0, 0};
+    }
+    return line_index_lookup(current, offset);
+}
@@ -0,0 +1,35 @@
+#ifndef LINES_H
+#define LINES_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+/*
+ * Tokens and AST nodes only keep a byte offset into the source. Lines
+ * and columns are worked out when a message needs one, from an index of
+ * line starts built on the first lookup.
+ */
+typedef struct {
+    int line;
+    int column;
+} SourcePosition;
+
+typedef struct {
+    const char* source;
+    size_t length;
+    unsigned int* starts; // NULL until the first lookup
+    size_t count;
+    // parts of a file are parsed on several threads (frontend.h)
+    pthread_mutex_t lock;
+} LineIndex;
+
+void line_index_init(LineIndex* index, const char* source, size_t length);
+void line_index_release(LineIndex* index);
+SourcePosition line_index_lookup(LineIndex* index, unsigned int offset);
+
+// The index of the source compiled on this thread (NULL outside of one)
+void line_index_set_current(LineIndex* index);
+// Position in that source, {0, 0} when there is none
+SourcePosition source_position(unsigned int offset);
+
+#endif
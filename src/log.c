@@ -0,0 +1,103 @@
+#include "log.h"
+#include <stdarg.h>
+#include <string.h>
+
+// errors and warnings only by default
+unsigned char log_levels[LOG_CATEGORY_COUNT] = {
+    [LOG_LEX] = LOG_LEVEL_WARNING,
+    [LOG_PARSE] = LOG_LEVEL_WARNING,
+    [LOG_AST] = LOG_LEVEL_WARNING,
+    [LOG_SEMA] = LOG_LEVEL_WARNING,
+    [LOG_CODEGEN] = LOG_LEVEL_WARNING,
+};
+
+static const char* category_names[LOG_CATEGORY_COUNT] = {
+    [LOG_LEX] = "lex",
+    [LOG_PARSE] = "parse",
+    [LOG_AST] = "ast",
+    [LOG_SEMA] = "sema",
+    [LOG_CODEGEN] = "codegen",
+};
+
+static const char* level_names[] = {
+    [LOG_LEVEL_ERROR] = "ERROR",
+    [LOG_LEVEL_WARNING] = "WARNING",
+    [LOG_LEVEL_INFO] = "INFO",
+    [LOG_LEVEL_DEBUG] = "DEBUG",
+};
+
+// batch workers point this to a per-input buffer
+static _Thread_local FILE* output = NULL;
+
+FILE* log_file(void) {
+    return output ? output : stderr;
+}
+
+void log_set_file(FILE* file) {
+    output = file;
+}
+
+void log_write(LogLevel level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    fprintf(log_file(), "%s - ", level_names[level]);
+    vfprintf(log_file(), format, args);
+    va_end(args);
+}
+
+void log_set_verbosity(int verbosity) {
+    // -v => INFO; -vv => DEBUG
+    LogLevel level = LOG_LEVEL_WARNING + verbosity;
+    if (level > LOG_LEVEL_DEBUG) {
+        level = LOG_LEVEL_DEBUG;
+    }
+    for (int i = 0; i < LOG_CATEGORY_COUNT; i++) {
+        if (log_levels[i] < level) {
+            log_levels[i] = level;
+        }
+    }
+}
+
+bool log_configure(const char* spec) {
+    /*
+     * Comma separated list of categories to trace (everything, DEBUG included)
+     * e.g. "lex,sema" or "all"
+     */
+    while (*spec) {
+        const char* end = strchr(spec, ',');
+        size_t length = end ? (size_t) (end - spec) : strlen(spec);
+
+        bool found = false;
+        for (int i = 0; i < LOG_CATEGORY_COUNT; i++) {
+            bool all = (length == 3) && (strncmp(spec, "all", 3) == 0);
+            if (all || ((strlen(category_names[i]) == length)
+                        && (strncmp(spec, category_names[i], length) == 0))) {
+                log_levels[i] = LOG_LEVEL_DEBUG;
+                found = true;
+            }
+        }
+        if (!found) {
+            fprintf(log_file(), "ERROR - Unknown log category '%.*s'\n", (int) length, spec);
+            return false;
+        }
+
+        spec += length;
+        if (*spec == ',') {
+            spec++;
+        }
+    }
+    return true;
+}
+
+FILE* log_stream(LogCategory category, LogLevel level) {
+    /*
+     * Stream for bulk debug output (IR dry runs and the like).
+     * NULL means nobody is listening so the caller can skip the formatting
+     */
+#ifdef HELK_NO_TRACE
+    if (level > LOG_LEVEL_WARNING) {
+        return NULL;
+    }
+#endif
+    return log_enabled(category, level) ? log_file() : NULL;
+}
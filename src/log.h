@@ -0,0 +1,58 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+typedef enum {
+    LOG_LEX,
+    LOG_PARSE,
+    LOG_AST,
+    LOG_SEMA,
+    LOG_CODEGEN,
+    LOG_CATEGORY_COUNT
+} LogCategory;
+
+typedef enum {
+    LOG_LEVEL_ERROR, // always on
+    LOG_LEVEL_WARNING,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG
+} LogLevel;
+
+// highest enabled level for every category
+// a disabled message costs a load and a compare
+extern unsigned char log_levels[LOG_CATEGORY_COUNT];
+
+#define log_enabled(category, level) (log_levels[(category)] >= (level))
+
+void log_write(LogLevel level, const char* format, ...)
+    __attribute__((format(printf, 2, 3)));
+void log_set_verbosity(int verbosity);
+bool log_configure(const char* spec);
+FILE* log_stream(LogCategory category, LogLevel level);
+
+// where messages of the current thread end up (stderr unless redirected)
+FILE* log_file(void);
+void log_set_file(FILE* file);
+
+#define LOG_AT(category, level, ...) \
+    do { \
+        if (log_enabled(category, level)) { \
+            log_write(level, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_ERROR(category, ...) log_write(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARNING(category, ...) LOG_AT(category, LOG_LEVEL_WARNING, __VA_ARGS__)
+
+// tracing is compiled out of release builds (make RELEASE=1)
+#ifdef HELK_NO_TRACE
+#define LOG_INFO(category, ...) ((void) 0)
+#define LOG_DEBUG(category, ...) ((void) 0)
+#else
+#define LOG_INFO(category, ...) LOG_AT(category, LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(category, ...) LOG_AT(category, LOG_LEVEL_DEBUG, __VA_ARGS__)
+#endif
+
+#endif
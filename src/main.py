@@ -1,11 +1,14 @@
 """
 Driver code
+
+    python src/main.py [--lexer-backend=goto|table] [--parser-backend=recursive|stack]
 """
+import sys
 from pathlib import Path
 
 from lexing.lexer import Lexer
 from parsing.dsl import DSLProcessor
-from parsing.generator import LL1CCodeGenerator
+from parsing.generator import PARSER_BACKENDS
 
 BASE_DIR = Path(__file__).parent
 
@@ -16,10 +19,18 @@ with open(BASE_DIR / "parser.helk") as file:
     parser_metadata = file.read()
 
 
+lexer_backend = "goto"
+parser_backend = "recursive"
+for arg in sys.argv[1:]:
+    if arg.startswith("--lexer-backend="):
+        lexer_backend = arg.split("=", 1)[1]
+    elif arg.startswith("--parser-backend="):
+        parser_backend = arg.split("=", 1)[1]
+
 tokens = eval(lexer_metadata)
 lexer_gen = Lexer(tokens, skip_whitespace=True)
-lexer_gen.generate_c_lexer(BASE_DIR)
+lexer_gen.generate_c_lexer(BASE_DIR, backend=lexer_backend)
 
 parser_gen = DSLProcessor(parser_metadata).generate_generator()
-code_gen = LL1CCodeGenerator(parser_gen)
+code_gen = PARSER_BACKENDS[parser_backend](parser_gen)
 code_gen.generate_parser_code(BASE_DIR)
@@ -0,0 +1,17 @@
+#ifndef NUMBER_H
+#define NUMBER_H
+
+#include <stddef.h>
+
+/*
+ * The value of a NUMBER token (digits, an optional fraction and an
+ * optional exponent), correctly rounded to a double. It is worked out
+ * once while parsing so the generated code only holds constants.
+ *
+ * Most literals take one exact multiplication or division (Clinger);
+ * the others take a 128-bit multiplication by a power of five
+ * (Eisel-Lemire), and the rare cases that leaves undecided go to strtod.
+ */
+double number_parse(const char* text, size_t length);
+
+#endif
@@ -1,3 +1,4 @@
+import re
 from pathlib import Path
 from collections import defaultdict, Counter
 
@@ -18,6 +19,9 @@ with open(BASE_DIR / "parser_header.txt") as file:
 with open(BASE_DIR / "parser_source_header.txt") as file:
     parser_source_header = file.read()
 
+with open(BASE_DIR / "parser_stack.txt") as file:
+    parser_stack = file.read()
+
 
 class LL1CCodeGenerator:
     """Generates optimized C code for LL(1) parser based on parsing table."""
@@ -67,7 +71,7 @@ class LL1CCodeGenerator:
 
         # Function prototypes for non-terminals
         for nt in self.non_terminals:
-            f.write(f"{self.ast_name}* {self.nt_to_func[nt]}(void);\n")
+            f.write(f"{self.ast_name}* {self.nt_to_func[nt]}(Parser* parser);\n")
         f.write("\n")
 
         # Helper functions
@@ -80,11 +84,57 @@ class LL1CCodeGenerator:
         # Main parsing function
         self._generate_main_parser(f)
 
+    def _tail_productions(self, nt):
+        """
+        The productions of nt that end in nt itself (and name it nowhere
+        else), like list tails. The recursive parser loops over those
+        instead of calling itself, so a list of n items takes one frame.
+        """
+        productions = []
+        for (nt_key, _), production in self.table.items():
+            production = tuple(production)
+            if nt_key != nt or production in productions:
+                continue
+            if production[-1] == nt and nt not in production[:-1]:
+                productions.append(production)
+        return productions
+
+    def _variables(self, production):
+        """(type, name) of the variable of every symbol in production."""
+        counter = Counter()
+        variables = []
+        for symbol in production:
+            if symbol == self.epsilon:
+                continue
+            counter[symbol] += 1
+            cls = "Token" if symbol not in self.non_terminals else "ASTNode*"
+            variables.append((cls, "_" * counter[symbol] + symbol))
+        return variables
+
+    def _generate_frame(self, f, nt, productions):
+        """What a loop iteration of a right recursive nt keeps for its action."""
+        func_name = self.nt_to_func[nt]
+        f.write("// The symbols before the recursion of a production of " + func_name + "\n")
+        f.write("typedef struct {\n")
+        f.write("    int production;\n")
+        fields = []
+        for production in productions:
+            for variable in self._variables(production[:-1]):
+                if variable not in fields:
+                    fields.append(variable)
+        for cls, name in fields:
+            f.write(f"    {cls} {name};\n")
+        f.write(f"}} {func_name}_Frame;\n\n")
+        return [name for _, name in fields]
+
     def _generate_non_terminal_function(self, f, nt):
         """Generate parsing function for a non-terminal."""
         func_name = self.nt_to_func[nt]
+        loops = self._tail_productions(nt)
+        if loops:
+            fields = self._generate_frame(f, nt, loops)
         # hard-coded node name (opinionated)
-        f.write(f"{self.ast_name}* {func_name}(void) {{\n")
+        f.write(f"{self.ast_name}* {func_name}(Parser* parser) {{\n")
         f.write("    TokenType sync_set[] = {")
 
         # Generate synchronization set (follow set)
@@ -96,9 +146,11 @@ class LL1CCodeGenerator:
         f.write("};\n")
         f.write(f"    int sync_size = sizeof(sync_set)/sizeof(sync_set[0]);\n\n")
         f.write(f"    {self.ast_name}* node = NULL;\n\n")
-        f.write(
-            f'    fprintf(stderr, "DEBUG - At {func_name} [current=%d]\\n", current_tok);\n\n'
-        )
+        if loops:
+            f.write(f"    // right recursive: the actions of the productions that loop run\n")
+            f.write(f"    // once the rest is parsed, innermost first like the calls would\n")
+            f.write(f"    {func_name}_Frame* frames = NULL;\n")
+            f.write(f"    size_t depth = 0;\n\n")
         # define variables
         defined = set()
         for (nt_key, token), production in self.table.items():
@@ -122,7 +174,12 @@ class LL1CCodeGenerator:
                     defined.add(prod)
 
         f.write("\n")
-        f.write("    switch (current_tok) {\n")
+        if loops:
+            f.write("again:\n")
+        f.write(
+            f'    LOG_DEBUG(LOG_PARSE, "At {func_name} [current=%d]\\n", parser->current_tok);\n\n'
+        )
+        f.write("    switch (parser->current_tok) {\n")
 
         # Group productions by their action
         cases = defaultdict(list)
@@ -156,10 +213,22 @@ class LL1CCodeGenerator:
             tail = "_"
             for symbol in production:
                 if symbol in self.terminals and symbol != self.epsilon:
-                    f.write(f"            {tail*(counter[symbol] + 1)}{symbol} = match_token(TOKEN_{symbol.upper()});\n")
+                    f.write(f"            {tail*(counter[symbol] + 1)}{symbol} = match_token(parser, TOKEN_{symbol.upper()});\n")
+                elif production in loops and symbol == nt:
+                    break
                 elif symbol in self.non_terminals:
-                    f.write(f"            {tail*(counter[symbol] + 1)}{symbol} = {self.nt_to_func[symbol]}();\n")
+                    f.write(f"            {tail*(counter[symbol] + 1)}{symbol} = {self.nt_to_func[symbol]}(parser);\n")
                 counter[symbol] += 1
+            if production in loops:
+                values = ", ".join(
+                    f".{name} = {name}" for _, name in self._variables(production[:-1])
+                )
+                f.write("            if ((depth & (depth - 1)) == 0) {\n")
+                f.write(f"                frames = hk_realloc(frames, sizeof({func_name}_Frame) * (depth == 0 ? 1 : 2 * depth));\n")
+                f.write("            }\n")
+                f.write(f"            frames[depth++] = ({func_name}_Frame) {{{loops.index(production)}, {values}}};\n")
+                f.write("            goto again;\n\n")
+                continue
             for kode in self.code.get((nt, tuple(production)), []):
                 # naively dumping unsanitized code into our parser!
                 f.write(f"            {kode}\n")
@@ -167,18 +236,40 @@ class LL1CCodeGenerator:
 
         # Default error case
         f.write("        default:\n")
-        f.write('            syntax_error("Unexpected token");\n')
-        f.write("            recover_from_error(sync_set, sync_size);\n")
+        f.write('            syntax_error(parser, "Unexpected token");\n')
+        f.write("            recover_from_error(parser, sync_set, sync_size);\n")
         f.write("            break;\n")
         f.write("    }\n")
-        f.write("    if ((node != NULL) && (current_index > 0) && (current_tok != TOKEN_EOF)) {\n")
-        f.write("        Token token = _current_token();\n")
-        f.write("        node->line = token.line;\n")
-        f.write("        node->column = token.column;\n")
-        f.write("    }\n")
+        self._write_offset(f, "    ")
+        if loops:
+            f.write("    while (depth > 0) {\n")
+            f.write(f"        {func_name}_Frame frame = frames[--depth];\n")
+            for name in fields:
+                f.write(f"        {name} = frame.{name};\n")
+            f.write(f"        _{nt} = node;\n")
+            f.write("        node = NULL;\n")
+            f.write("        switch (frame.production) {\n")
+            for i, production in enumerate(loops):
+                f.write(f"            case {i}: {{\n")
+                f.write("                // Production: " + " ".join(production) + "\n")
+                for kode in self.code.get((nt, production), []):
+                    f.write(f"                {kode}\n")
+                f.write("                break;\n")
+                f.write("            }\n")
+            f.write("        }\n")
+            self._write_offset(f, "        ")
+            f.write("    }\n")
+            f.write("    hk_free(frames);\n")
         f.write("    return node;\n")
         f.write("}\n\n")
 
+    def _write_offset(self, f, indent):
+        """A finished node takes the offset of the last token consumed."""
+        f.write(f"{indent}if ((node != NULL) && (parser->current_index > 0) && (parser->current_tok != TOKEN_EOF)) {{\n")
+        f.write(f"{indent}    Token token = _current_token(parser);\n")
+        f.write(f"{indent}    node->offset = token.offset;\n")
+        f.write(f"{indent}}}\n")
+
     def _generate_main_parser(self, f):
         """Generate main parsing function."""
         start_func = self.nt_to_func[self.parser.start_symbol]
@@ -190,6 +281,218 @@ class LL1CCodeGenerator:
         )
 
 
+class LL1StackCodeGenerator(LL1CCodeGenerator):
+    """
+    The same parsing table, driven by one loop over an explicit stack
+    instead of a C function per non-terminal, so nesting is bounded by
+    the heap rather than by the C stack.
+
+    Expanding a non-terminal matches the terminals its production starts
+    with, pushes a reduce entry and the rest of the right-hand side back
+    to front, and goes on with the first non-terminal in it. Every symbol
+    fills its slot on a value stack (tokens from match_token, nodes from
+    the reduce of their production) and the reduce runs the grammar
+    action over those slots once the last symbol is done; productions
+    with no non-terminal run theirs on the spot. That is the
+    order the recursive parser goes in, so both build the same AST and
+    report the same errors.
+    """
+
+    def _productions(self):
+        """(non-terminal, right-hand side) pairs; ids start at 1."""
+        return [
+            (nt, tuple(symbol for symbol in prod if symbol != self.epsilon))
+            for nt in sorted(self.non_terminals)
+            for prod in self.parser.grammar[nt]
+        ]
+
+    def _action(self, nt, rhs):
+        code = self.code.get((nt, rhs or (self.epsilon,)), [])
+        return code if any(line.strip() for line in code) else []
+
+    def _entry(self, symbol):
+        if symbol in self.non_terminals:
+            return f"ENTRY_NON_TERMINAL, NT_{self.nt_to_func[symbol]}"
+        return f"ENTRY_TERMINAL, TOKEN_{symbol.upper()}"
+
+    def _generate_source(self, f):
+        f.write(parser_source_header)
+        f.write(parser_helpers)
+        f.write("\n")
+
+        non_terminals = sorted(self.non_terminals)
+        productions = self._productions()
+        production_id = {production: i + 1 for i, production in enumerate(productions)}
+
+        f.write("typedef enum {\n")
+        for nt in non_terminals:
+            f.write(f"    NT_{self.nt_to_func[nt]},\n")
+        f.write("    NT_COUNT,\n")
+        f.write("} NonTerminal;\n\n")
+
+        f.write("#ifndef HELK_NO_TRACE\n")
+        f.write("static const char* non_terminal_names[NT_COUNT] = {\n")
+        for nt in non_terminals:
+            f.write(f'    "{self.nt_to_func[nt]}",\n')
+        f.write("};\n")
+        f.write("#endif\n\n")
+
+        f.write(
+            "typedef enum {\n"
+            "    ENTRY_TERMINAL,\n"
+            "    ENTRY_NON_TERMINAL,\n"
+            "    ENTRY_REDUCE,\n"
+            "} EntryKind;\n\n"
+            "typedef struct {\n"
+            "    uint8_t kind;\n"
+            "    uint16_t symbol; // token, non-terminal or production\n"
+            "    uint32_t slot;   // where the value goes on the value stack\n"
+            "} StackEntry;\n\n"
+        )
+        f.write(f"typedef union {{\n    Token token;\n    {self.ast_name}* node;\n}} Value;\n\n")
+
+        f.write(f"#define MAX_RHS {max(len(rhs) for _, rhs in productions)}\n\n")
+        f.write("// symbols on the right-hand side of every production\n")
+        f.write(f"static const uint8_t production_lengths[{len(productions) + 1}] = {{\n    0,\n")
+        for nt, rhs in productions:
+            f.write(f"    {len(rhs)}, // {nt}: {' '.join(rhs) or 'epsilon'}\n")
+        f.write("};\n\n")
+
+        # 0 where the recursive parser takes its default case
+        tokens = sorted({token for _, token in self.table})
+        f.write("static const uint8_t parse_table[NT_COUNT][TOKEN_ERROR + 1] = {\n")
+        for nt in non_terminals:
+            f.write(f"    [NT_{self.nt_to_func[nt]}] = {{\n")
+            for token in tokens:
+                prod = self.table.get((nt, token))
+                if prod is None:
+                    continue
+                rhs = tuple(symbol for symbol in prod if symbol != self.epsilon)
+                f.write(f"        [TOKEN_{token.upper()}] = {production_id[(nt, rhs)]},\n")
+            f.write("    },\n")
+        f.write("};\n\n")
+
+        # error recovery skips to the follow set, as in the recursive parser
+        for nt in non_terminals:
+            follow = sorted(t for t in self.follow.get(nt, set()) if t != self.epsilon)
+            sync = sorted({f"TOKEN_{t.upper()}" for t in follow} | {f"TOKEN_{self.end_marker.upper()}"})
+            f.write(f"static TokenType sync_{self.nt_to_func[nt]}[] = {{{', '.join(sync)}}};\n")
+        f.write("\nstatic const struct {\n    TokenType* set;\n    int size;\n} sync_sets[NT_COUNT] = {\n")
+        for nt in non_terminals:
+            name = self.nt_to_func[nt]
+            f.write(f"    [NT_{name}] = {{sync_{name}, sizeof(sync_{name}) / sizeof(TokenType)}},\n")
+        f.write("};\n\n")
+
+        self._generate_reduce(f, productions)
+        expansions = "".join(
+            self._expansion(i + 1, nt, rhs) for i, (nt, rhs) in enumerate(productions)
+        )
+        start = f"NT_{self.nt_to_func[self.parser.start_symbol]}"
+        f.write(parser_stack.format(ast_name=self.ast_name, start=start, expansions=expansions.rstrip()))
+        f.write(parser_main.format(start_func="parse_with_stack", ast_name=self.ast_name))
+
+    def _names(self, nt, rhs):
+        """The variable of every symbol in rhs, None where the action does not read it."""
+        code = "\n".join(self._action(nt, rhs))
+        counter = Counter()
+        names = []
+        for symbol in rhs:
+            counter[symbol] += 1
+            name = "_" * counter[symbol] + symbol
+            found = re.search(rf"(?<!\w){re.escape(name)}(?!\w)", code)
+            names.append(name if found else None)
+        return names
+
+    def _generate_reduce(self, f, productions):
+        """The actions of the productions that wait for a non-terminal."""
+        f.write(
+            "// A finished node takes the offset of the last token consumed, as in\n"
+            "// the recursive parser\n"
+            f"static inline {self.ast_name}* finish_node(Parser* parser, {self.ast_name}* node) {{\n"
+            "    if ((node != NULL) && (parser->current_index > 0) && (parser->current_tok != TOKEN_EOF)) {\n"
+            "        Token token = _current_token(parser);\n"
+            "        node->offset = token.offset;\n"
+            "    }\n"
+            "    return node;\n"
+            "}\n\n"
+        )
+        f.write("// The action of production over the values of its right-hand side\n")
+        f.write(f"static {self.ast_name}* reduce(Parser* parser, int production, Value* frame) {{\n")
+        f.write(f"    {self.ast_name}* node = NULL;\n")
+        f.write("    switch (production) {\n")
+        for i, (nt, rhs) in enumerate(productions):
+            action = self._action(nt, rhs)
+            if not action or self._immediate(rhs):
+                continue
+            f.write(f"        case {i + 1}: {{\n")
+            f.write(f"            // Production: {nt} -> {' '.join(rhs)}\n")
+            for slot, (symbol, name) in enumerate(zip(rhs, self._names(nt, rhs))):
+                if name is None:
+                    continue
+                if symbol in self.non_terminals:
+                    f.write(f"            {self.ast_name}* {name} = frame[{slot}].node;\n")
+                else:
+                    f.write(f"            Token {name} = frame[{slot}].token;\n")
+            for kode in action:
+                f.write(f"            {kode}\n")
+            f.write("            break;\n")
+            f.write("        }\n")
+        f.write("    }\n")
+        f.write("    return finish_node(parser, node);\n")
+        f.write("}\n\n")
+
+    def _immediate(self, rhs):
+        """Whether a production is done once its first terminals are matched."""
+        return all(symbol not in self.non_terminals for symbol in rhs)
+
+    def _expansion(self, production, nt, rhs):
+        """The case of the parse loop that expands nt by production."""
+        lines = [f"        case {production}: // {nt}: {' '.join(rhs) or 'epsilon'}"]
+        if self._immediate(rhs):
+            # nothing to wait for: the action runs right here
+            action = self._action(nt, rhs)
+            if not action:
+                for symbol in rhs:
+                    lines.append(f"            match_token(parser, TOKEN_{symbol.upper()});")
+                lines.append("            values[slot].node = NULL;")
+                lines.append("            goto next;")
+                return "\n".join(lines) + "\n"
+            lines[0] = f"        case {production}: {{ // {nt}: {' '.join(rhs) or 'epsilon'}"
+            lines.append(f"            {self.ast_name}* node = NULL;")
+            for symbol, name in zip(rhs, self._names(nt, rhs)):
+                if name is None:
+                    lines.append(f"            match_token(parser, TOKEN_{symbol.upper()});")
+                else:
+                    lines.append(f"            Token {name} = match_token(parser, TOKEN_{symbol.upper()});")
+            # a block of its own, the action may name things like the loop does
+            lines.append("            {")
+            for kode in action:
+                lines.append(f"                {kode}")
+            lines.append("            }")
+            lines.append("            values[slot].node = finish_node(parser, node);")
+            lines.append("            goto next;")
+            lines.append("        }")
+            return "\n".join(lines) + "\n"
+        leading = 0
+        while rhs[leading] not in self.non_terminals:
+            lines.append(f"            values[values_top + {leading}].token = match_token(parser, TOKEN_{rhs[leading].upper()});")
+            leading += 1
+        lines.append(f"            stack[top++] = (StackEntry) {{ENTRY_REDUCE, {production}, slot}};")
+        for i in reversed(range(leading + 1, len(rhs))):
+            lines.append(f"            stack[top++] = (StackEntry) {{{self._entry(rhs[i])}, values_top + {i}}};")
+        lines.append(f"            symbol = NT_{self.nt_to_func[rhs[leading]]};")
+        lines.append(f"            slot = values_top + {leading};")
+        lines.append(f"            values_top += {len(rhs)};")
+        lines.append("            goto expand;")
+        return "\n".join(lines) + "\n"
+
+
+PARSER_BACKENDS = {
+    "recursive": LL1CCodeGenerator,
+    "stack": LL1StackCodeGenerator,
+}
+
+
 # Example usage
 if __name__ == "__main__":
     # Example grammar
@@ -0,0 +1,173 @@
+#include "scan.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* scalar_whitespace(const char* p) {
+    while (scan_is_blank(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static const char* scalar_word(const char* p) {
+    while (scan_is_word(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static const char* scalar_digits(const char* p) {
+    while (scan_is_digit(*p)) {
+        p++;
+    }
+    return p;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define FULL(width) ((width) == 64 ? ~0ULL : (1ULL << (width)) - 1)
+
+// whole aligned blocks are read, bytes past the '\0' included
+#define KERNEL(isa) __attribute__((target(isa), no_sanitize_address))
+
+/*
+ * The loops are the same for every width; CLASS(block) gives a mask
+ * with bit i set when byte i belongs to the run.
+ */
+#define SCAN_RUN(width, CLASS)                                          \
+    uintptr_t offset = (uintptr_t) p & ((width) - 1);                   \
+    const char* block = p - offset;                                     \
+    uint64_t stop = ~CLASS(block) & (FULL(width) << offset) & FULL(width); \
+    while (stop == 0) {                                                 \
+        block += (width);                                               \
+        stop = ~CLASS(block) & FULL(width);                             \
+    }                                                                   \
+    return block + __builtin_ctzll(stop);
+
+// SSE2 (every x86-64)
+
+KERNEL("sse2") static inline uint64_t sse2_eq(__m128i v, char c) {
+    return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+}
+
+KERNEL("sse2") static inline uint64_t sse2_range(__m128i v, char low, char high) {
+    // no unsigned compares: clamp and see what stayed put
+    __m128i clamped = _mm_max_epu8(_mm_min_epu8(v, _mm_set1_epi8(high)), _mm_set1_epi8(low));
+    return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(clamped, v));
+}
+
+KERNEL("sse2") static inline uint64_t sse2_word_class(const char* block) {
+    __m128i v = _mm_load_si128((const __m128i*) block);
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    return sse2_range(lower, 'a', 'z') | sse2_range(v, '0', '9') | sse2_eq(v, '_');
+}
+
+KERNEL("sse2") static inline uint64_t sse2_digit_class(const char* block) {
+    return sse2_range(_mm_load_si128((const __m128i*) block), '0', '9');
+}
+
+KERNEL("sse2") static inline uint64_t sse2_blank_class(const char* block) {
+    __m128i v = _mm_load_si128((const __m128i*) block);
+    return sse2_eq(v, ' ') | sse2_eq(v, '\n') | sse2_eq(v, '\t') | sse2_eq(v, '\r');
+}
+
+KERNEL("sse2") static const char* sse2_whitespace(const char* p) {
+    SCAN_RUN(16, sse2_blank_class)
+}
+
+KERNEL("sse2") static const char* sse2_word(const char* p) {
+    SCAN_RUN(16, sse2_word_class)
+}
+
+KERNEL("sse2") static const char* sse2_digits(const char* p) {
+    SCAN_RUN(16, sse2_digit_class)
+}
+
+// AVX2
+
+KERNEL("avx2") static inline uint64_t avx2_eq(__m256i v, char c) {
+    return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+}
+
+KERNEL("avx2") static inline uint64_t avx2_range(__m256i v, char low, char high) {
+    __m256i clamped = _mm256_max_epu8(_mm256_min_epu8(v, _mm256_set1_epi8(high)), _mm256_set1_epi8(low));
+    return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(clamped, v));
+}
+
+KERNEL("avx2") static inline uint64_t avx2_word_class(const char* block) {
+    __m256i v = _mm256_load_si256((const __m256i*) block);
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    return avx2_range(lower, 'a', 'z') | avx2_range(v, '0', '9') | avx2_eq(v, '_');
+}
+
+KERNEL("avx2") static inline uint64_t avx2_digit_class(const char* block) {
+    return avx2_range(_mm256_load_si256((const __m256i*) block), '0', '9');
+}
+
+KERNEL("avx2") static inline uint64_t avx2_blank_class(const char* block) {
+    __m256i v = _mm256_load_si256((const __m256i*) block);
+    return avx2_eq(v, ' ') | avx2_eq(v, '\n') | avx2_eq(v, '\t') | avx2_eq(v, '\r');
+}
+
+KERNEL("avx2") static const char* avx2_whitespace(const char* p) {
+    SCAN_RUN(32, avx2_blank_class)
+}
+
+KERNEL("avx2") static const char* avx2_word(const char* p) {
+    SCAN_RUN(32, avx2_word_class)
+}
+
+KERNEL("avx2") static const char* avx2_digits(const char* p) {
+    SCAN_RUN(32, avx2_digit_class)
+}
+
+#endif
+
+static struct {
+    const char* name;
+    const char* (*whitespace)(const char*);
+    const char* (*word)(const char*);
+    const char* (*digits)(const char*);
+} kernel = {"scalar", scalar_whitespace, scalar_word, scalar_digits};
+
+// HELK_SCAN=scalar|sse2 pins a narrower kernel, for comparisons
+__attribute__((constructor)) static void pick_kernel(void) {
+    const char* wanted = getenv("HELK_SCAN");
+    if (wanted && strcmp(wanted, "scalar") == 0) {
+        return;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    bool sse2_only = wanted && strcmp(wanted, "sse2") == 0;
+    if (__builtin_cpu_supports("avx2") && !sse2_only) {
+        kernel.name = "avx2";
+        kernel.whitespace = avx2_whitespace;
+        kernel.word = avx2_word;
+        kernel.digits = avx2_digits;
+    }
+    else if (__builtin_cpu_supports("sse2")) {
+        kernel.name = "sse2";
+        kernel.whitespace = sse2_whitespace;
+        kernel.word = sse2_word;
+        kernel.digits = sse2_digits;
+    }
+#endif
+}
+
+const char* scan_whitespace_run(const char* p) {
+    return kernel.whitespace(p);
+}
+
+const char* scan_word_run(const char* p) {
+    return kernel.word(p);
+}
+
+const char* scan_digits_run(const char* p) {
+    return kernel.digits(p);
+}
+
+const char* scan_kernel(void) {
+    return kernel.name;
+}
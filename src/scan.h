@@ -0,0 +1,72 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdbool.h>
+
+/*
+ * Byte-run scanners for the lexer. They classify 16 (SSE2) or 32 (AVX2)
+ * bytes at a time; the kernel is picked once at startup from what the
+ * CPU supports, with a plain loop everywhere else.
+ *
+ * The input must be '\0' terminated: loads are aligned, so they never
+ * cross into a page that does not hold a byte of the input, and '\0'
+ * ends every run.
+ *
+ * Most runs are short (one space between tokens, `x`, `10`), so the
+ * first SCAN_SHORT bytes are looked at inline and only longer runs go
+ * through the kernel.
+ */
+
+#define SCAN_SHORT 8
+
+// the kernels
+const char* scan_whitespace_run(const char* p);
+const char* scan_word_run(const char* p);
+const char* scan_digits_run(const char* p);
+
+static inline bool scan_is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline bool scan_is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool scan_is_word(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || scan_is_digit(c) || c == '_';
+}
+
+// first byte that is not ' ', '\t', '\n' or '\r'
+static inline const char* scan_whitespace(const char* p) {
+    // nothing, or a single space
+    int length = (p[0] == ' ') ? 1 : 0;
+    if (!scan_is_blank(p[length])) {
+        return p + length;
+    }
+    return scan_whitespace_run(p);
+}
+
+// first byte that is not [a-zA-Z0-9_]
+static inline const char* scan_word(const char* p) {
+    for (int i = 0; i < SCAN_SHORT; i++) {
+        if (!scan_is_word(p[i])) {
+            return p + i;
+        }
+    }
+    return scan_word_run(p + SCAN_SHORT);
+}
+
+// first byte that is not [0-9]
+static inline const char* scan_digits(const char* p) {
+    for (int i = 0; i < SCAN_SHORT; i++) {
+        if (!scan_is_digit(p[i])) {
+            return p + i;
+        }
+    }
+    return scan_digits_run(p + SCAN_SHORT);
+}
+
+// "avx2", "sse2" or "scalar"
+const char* scan_kernel(void);
+
+#endif
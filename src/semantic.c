@@ -1,42 +1,41 @@
 #include "semantic.h"
 #include "ast.h"
+#include "log.h"
+#include "compiler.h"
+#include "arena.h"
+#include "timer.h"
+#include "intern.h"
+#include "lines.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
 
-int phase = 0;
-
-size_t hash(const char* s) {
-    size_t h = 5381;
-    while(*s) h = ((h << 5) + h) + *s++;
-    return h;
-}
 
 static char* new_constructor(char* cls) {
-    char* temp = malloc(16 + 16 + 16);
+    char* temp = hk_malloc(strlen(cls) + sizeof("_constructor"));
     sprintf(temp, "%s_constructor", cls);
-    return temp;
+    return intern(temp);
 }
 
 static char* new_instance_type(char* cls) {
-    char* temp = malloc(16 + 16 + 16);
+    char* temp = hk_malloc(strlen(cls) + sizeof("%struct.*"));
     sprintf(temp, "%%struct.%s*", cls);
     return temp;
 }
 
 static char* new_method(char* cls, ASTNode* node) {
-    char* temp = malloc(16 + 16 + 16);
+    char* temp = hk_malloc(strlen(cls) + strlen(node->method_call.method) + 2);
     // NOTE add arg types
     sprintf(temp, "%s_%s", cls, node->method_call.method);
-    return temp;
+    return intern(temp);
 }
 
 void coerce(ASTNode* node) {
     for (unsigned int j = 0; j < node->type_decl.method_count; j++) {
         node->type_decl.methods[j]->function_def.args_definitions[0]->type_info.name = new_instance_type(node->type_decl.name);
-        node->type_decl.methods[j]->function_def.args_definitions[0]->type_info.cls = strdup(node->type_decl.name);
-        node->type_decl.methods[j]->function_def.args_definitions[0]->type_info.kind = hash(node->type_decl.name);
+        node->type_decl.methods[j]->function_def.args_definitions[0]->type_info.cls = node->type_decl.name;
+        node->type_decl.methods[j]->function_def.args_definitions[0]->type_info.kind = intern_hash(node->type_decl.name);
         node->type_decl.methods[j]->function_def.args_definitions[0]->type_info.parent = node->type_info.parent;
         node->type_decl.methods[j]->function_def.args_definitions[0]->type_info.is_polymorphic = true;
     }
@@ -47,9 +46,7 @@ TypeInfo* common_ancestor(TypeInfo* t1, TypeInfo* t2) {
     if (t1->kind == t2->kind) return t2;
     if (t2->kind <= 2) return t2;
 
-    fprintf(
-        stderr,
-        "INFO - Searching for the common ancestor between %zu and %zu\n",
+    LOG_INFO(LOG_SEMA, "Searching for the common ancestor between %zu and %zu\n",
         t1->kind, t2->kind
     );
 
@@ -59,7 +56,7 @@ TypeInfo* common_ancestor(TypeInfo* t1, TypeInfo* t2) {
 
     TypeInfo* current = t1;
     while (current && (ancestor_count < sizeof(ancestors)/sizeof(ancestors[0]) - 1)) {
-        fprintf(stderr, "DEBUG - Found ancestor %zu\n", current->kind);
+        LOG_DEBUG(LOG_SEMA, "Found ancestor %zu\n", current->kind);
         ancestors[ancestor_count++] = current;
         current = current->parent;
     }
@@ -69,21 +66,22 @@ TypeInfo* common_ancestor(TypeInfo* t1, TypeInfo* t2) {
     while (current) {
         for (size_t i = 0; i < ancestor_count; i++) {
             if (current->kind == ancestors[i]->kind) {
-                fprintf(stderr, "INFO - Found common ancestor %zu\n", current->kind);
+                LOG_INFO(LOG_SEMA, "Found common ancestor %zu\n", current->kind);
                 return current;
             }
         }
         current = current->parent;
     }
 
-    fprintf(stderr, "ERORR - No common ancestor!\n");
+    LOG_ERROR(LOG_SEMA, "No common ancestor!\n");
 
     return NULL;
 }
 
 // type inference
 bool solve_constraints(ConstraintSystem* cs) {
-    fprintf(stderr, "INFO - Solving constraints...\n");
+    timer_begin(PASS_SOLVE_CONSTRAINTS);
+    LOG_INFO(LOG_SEMA, "Solving constraints...\n");
     bool changed;
     bool res = true;
     do {
@@ -92,16 +90,16 @@ bool solve_constraints(ConstraintSystem* cs) {
             TypeConstraint* c = &cs->constraints[i];
             TypeInfo* t = c->expected;
             if (c->node == NULL) {
-                fprintf(stderr, "ERROR -Invalid constraint (c->node is null))! %p %zu\n", c->node, t->kind);
-                exit(1);
+                LOG_ERROR(LOG_SEMA, "Invalid constraint (c->node is null))! %p %zu\n", c->node, t->kind);
+                compile_fail();
                 continue;
             }
-            //fprintf(stderr, "DEBUG - %d %p %p\n", c->node->type, t, c->node, c->node->type_info);
+            //LOG_DEBUG(LOG_SEMA, "%d %p %p\n", c->node->type, t, c->node, c->node->type_info);
             if (t == NULL) {
-                fprintf(stderr, "ERROR - Null constraint detected\n");
+                LOG_ERROR(LOG_SEMA, "Null constraint detected\n");
                 if (c->node->type == AST_VARIABLE) {
                     // error constraint
-                    fprintf(stderr, "%s",c->node->variable.name);
+                    LOG_ERROR(LOG_SEMA, "%s", c->node->variable.name);
                     res = false;
                 }
                 continue;
@@ -109,27 +107,27 @@ bool solve_constraints(ConstraintSystem* cs) {
             size_t expected = t->kind;
             size_t actual = c->node->type_info.kind;
 
-            fprintf(stderr, "DEBUG - Expected: %zu ; Actual: %zu ; Node: %d\n\n", expected, actual, c->node->type);
+            LOG_DEBUG(LOG_SEMA, "Expected: %zu ; Actual: %zu ; Node: %d\n\n", expected, actual, c->node->type);
 
             if (c->node->type == AST_FUNCTION_CALL) {
-                //fprintf(stderr, "For function %s\n", c->node->function_call.name);
+                //LOG_DEBUG(LOG_SEMA, "For function %s\n", c->node->function_call.name);
             }
             else if (c->node->type == AST_VARIABLE_DEF) {
-                //fprintf(stderr, "For variable %s\n", c->node->variable_def.name);
+                //LOG_DEBUG(LOG_SEMA, "For variable %s\n", c->node->variable_def.name);
             }
 
             if (c->node->type_info.cls != NULL) {
-                //fprintf(stderr, "With type %s\n", c->node->type_info.name);
+                //LOG_DEBUG(LOG_SEMA, "With type %s\n", c->node->type_info.name);
             }
             if (t->cls != NULL) {
-                //fprintf(stderr, "Expected type %s\n", t->name);
+                //LOG_DEBUG(LOG_SEMA, "Expected type %s\n", t->name);
             }
 
             // Propagate concrete -> unknown
             if((expected != TYPE_UNKNOWN
                && actual == TYPE_UNKNOWN)
             ) {
-                fprintf(stderr, "INFO - Solved type for node type=%d; to %zu\n", c->node->type, c->node->type_info.kind);
+                LOG_INFO(LOG_SEMA, "Solved type for node type=%d; to %zu\n", c->node->type, c->node->type_info.kind);
 
                 c->node->type_info.kind = ((TypeInfo*) (c->expected))->kind;
                 c->node->type_info.name = ((TypeInfo*) (c->expected))->name;
@@ -144,7 +142,7 @@ bool solve_constraints(ConstraintSystem* cs) {
             if((expected == TYPE_UNKNOWN
                && actual != TYPE_UNKNOWN)
             ) {
-                fprintf(stderr, "INFO - Solved type for node type=%d; to %zu\n", c->node->type, c->node->type_info.kind);
+                LOG_INFO(LOG_SEMA, "Solved type for node type=%d; to %zu\n", c->node->type, c->node->type_info.kind);
 
                 ((TypeInfo*) (c->expected))->kind = c->node->type_info.kind;
                 ((TypeInfo*) (c->expected))->name = c->node->type_info.name;
@@ -164,9 +162,10 @@ bool solve_constraints(ConstraintSystem* cs) {
                 TypeInfo* ca = common_ancestor(&c->node->type_info, t);
                 if (ca == NULL) {
                     // XXX
-                    fprintf(stderr, "ERROR - Literal type mismatch (current_type=%d); [%d, %d]\n", c->node->type, c->node->line, c->node->column);
+                    SourcePosition position = source_position(c->node->offset);
+                    LOG_ERROR(LOG_SEMA, "Literal type mismatch (current_type=%d); [%d, %d]\n", c->node->type, position.line, position.column);
                     res = false;
-                    exit(1);
+                    compile_fail();
                 }
                 else {
                     c->node->type_info.kind = ca->kind;
@@ -185,6 +184,7 @@ bool solve_constraints(ConstraintSystem* cs) {
         }
     } while(changed);
 
+    timer_end(PASS_SOLVE_CONSTRAINTS);
     return res;
 }
 
@@ -192,7 +192,7 @@ void add_constraint(ConstraintSystem* cs, ASTNode* node,
                    TypeInfo* expected) {
     if (cs->count >= cs->capacity) {
         cs->capacity = cs->capacity ? cs->capacity * 2 : 16;
-        cs->constraints = realloc(cs->constraints, 
+        cs->constraints = hk_realloc(cs->constraints, 
                                 cs->capacity * sizeof(TypeConstraint));
     }
     cs->constraints[cs->count++] = (TypeConstraint){
@@ -203,54 +203,64 @@ void add_constraint(ConstraintSystem* cs, ASTNode* node,
 
 
 SymbolTable* create_symbol_table(SymbolTable* parent) {
-    SymbolTable* st = malloc(sizeof(SymbolTable));
-    st->entries = calloc(16, sizeof(SymbolEntry*));
+    SymbolTable* st = hk_malloc(sizeof(SymbolTable));
+    st->entries = hk_calloc(16, sizeof(SymbolEntry*));
     st->size = 16;
     st->parent = parent;
 
-    if (parent == NULL) {
-        // init builtins
-        char **pargs = malloc(sizeof(char*)*1);
-        pargs[0] = "[print_param_1]";
-        ASTNode* print = create_ast_function_def("print", NULL, pargs, 1);
-        print->type_info.kind = TYPE_DOUBLE;
-        symbol_table_add(st, "print", print);
-
-        char **psargs = malloc(sizeof(char*)*1);
-        psargs[0] = "[prints_param_1]";
-        ASTNode* prints = create_ast_function_def("prints", NULL, psargs, 1);
-        prints->type_info.kind = TYPE_DOUBLE;
-        symbol_table_add(st, "prints", prints);
-
-        char **maxargs = malloc(sizeof(char*)*2);
-        maxargs[0] = "[max_param_1]";
-        maxargs[1] = "[max_param_2]";
-        ASTNode* maxima = create_ast_function_def("max", NULL, maxargs, 2);
-        maxima->type_info.kind = TYPE_DOUBLE;
-        symbol_table_add(st, "max", maxima);
-
-        char **minargs = malloc(sizeof(char*)*2);
-        minargs[0] = "[min_param_1]";
-        minargs[1] = "[min_param_2]";
-        ASTNode* minima = create_ast_function_def("min", NULL, minargs, 2);
-        minima->type_info.kind = TYPE_DOUBLE;
-        symbol_table_add(st, "min", minima);
-
-        char **pow_args = malloc(sizeof(char*)*2);
-        pow_args[0] = "[pow_param_1]";
-        pow_args[1] = "[pow_param_2]";
-        ASTNode* power = create_ast_function_def("pow", NULL, pow_args, 2);
-        power->type_info.kind = TYPE_DOUBLE;
-        symbol_table_add(st, "pow", power);
+    return st;
+}
+
+static struct {
+    char* name;
+    char* args[2];
+    unsigned int arg_count;
+} builtins[] = {
+    {"print", {"[print_param_1]"}, 1},
+    {"prints", {"[prints_param_1]"}, 1},
+    {"max", {"[max_param_1]", "[max_param_2]"}, 2},
+    {"min", {"[min_param_1]", "[min_param_2]"}, 2},
+    {"pow", {"[pow_param_1]", "[pow_param_2]"}, 2},
+};
+
+static void reset_builtin(ASTNode* builtin) {
+    // analysis marks the builtins as called and solves their parameters
+    builtin->function_def.called = false;
+    builtin->type_info = (TypeInfo) {.kind = TYPE_DOUBLE};
+    for (unsigned int i = 0; i < builtin->function_def.arg_count; i++) {
+        builtin->function_def.args_definitions[i]->type_info = (TypeInfo) {.kind = TYPE_UNKNOWN};
+    }
+}
+
+SymbolTable* create_prelude(void) {
+    SymbolTable* st = create_symbol_table(NULL);
+
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+        char** args = hk_malloc(sizeof(char*) * builtins[i].arg_count);
+        for (unsigned int j = 0; j < builtins[i].arg_count; j++) {
+            args[j] = intern(builtins[i].args[j]);
+        }
+        char* name = intern(builtins[i].name);
+        ASTNode* builtin = create_ast_function_def(name, NULL, args, builtins[i].arg_count);
+        reset_builtin(builtin);
+        symbol_table_add(st, name, builtin);
     }
 
     return st;
 }
 
+void prelude_reset(SymbolTable* prelude) {
+    for (size_t i = 0; i < prelude->size; i++) {
+        for (SymbolEntry* e = prelude->entries[i]; e; e = e->next) {
+            reset_builtin(e->node);
+        }
+    }
+}
+
 void symbol_table_add(SymbolTable* st, const char* name, ASTNode* node) {
-    size_t idx = hash(name) % st->size;
-    SymbolEntry* entry = malloc(sizeof(SymbolEntry));
-    entry->name = strdup(name);
+    size_t idx = intern_hash(name) % st->size;
+    SymbolEntry* entry = hk_malloc(sizeof(SymbolEntry));
+    entry->name = (char*) name;
     entry->node = node;
     entry->next = st->entries[idx];
     st->entries[idx] = entry;
@@ -258,10 +268,10 @@ void symbol_table_add(SymbolTable* st, const char* name, ASTNode* node) {
 
 ASTNode* symbol_table_lookup(SymbolTable* st, const char* name) {
     for(SymbolTable* curr = st; curr; curr = curr->parent) {
-        size_t idx = hash(name) % curr->size;
+        size_t idx = intern_hash(name) % curr->size;
         for(SymbolEntry* e = curr->entries[idx]; e; e = e->next) {
-            if(strcmp(e->name, name) == 0) {
-                fprintf(stderr, "INFO - Found symbol %s\n", name);
+            if(e->name == name) {
+                LOG_INFO(LOG_SEMA, "Found symbol %s\n", name);
                 return e->node;
             }
         }
@@ -271,15 +281,13 @@ ASTNode* symbol_table_lookup(SymbolTable* st, const char* name) {
 
 ASTNode* lookup_method(char* name, ASTNode* cls, SymbolTable* scope) {
     for (unsigned int i = 0; i < cls->type_decl.method_count; i++) {
-        if (strcmp(cls->type_decl.methods[i]->function_def.name, name) == 0) {
+        if (cls->type_decl.methods[i]->function_def.name == name) {
             return cls->type_decl.methods[i];
         }
     }
     // didn't find it
     if (cls->type_decl.base_type) {
-        fprintf(
-            stderr,
-            "INFO - Found child class '%s' of '%s'\n",
+        LOG_INFO(LOG_SEMA, "Found child class '%s' of '%s'\n",
             cls->type_decl.name,
             cls->type_decl.base_type
         );
@@ -292,17 +300,15 @@ ASTNode* lookup_method(char* name, ASTNode* cls, SymbolTable* scope) {
         }
     }
     // didn't find it in parent class
-    fprintf(stderr, "ERROR - No method called %s in %s\n", name, cls->type_decl.name);
-    exit(1);
+    LOG_ERROR(LOG_SEMA, "No method called %s in %s\n", name, cls->type_decl.name);
+    compile_fail();
     return NULL;
 }
 
 int lookup_index(ASTNode* node, ASTNode* cls, SymbolTable* scope, ASTNode** correct_field) {
     int index = 0;
     if (cls->type_decl.base_type) {
-        fprintf(
-            stderr,
-            "INFO - Found child class '%s' of '%s'\n",
+        LOG_INFO(LOG_SEMA, "Found child class '%s' of '%s'\n",
             cls->type_decl.name,
             cls->type_decl.base_type
         );
@@ -319,16 +325,12 @@ int lookup_index(ASTNode* node, ASTNode* cls, SymbolTable* scope, ASTNode** corr
     }
 
     for (int i = 0; i < (int) cls->type_decl.field_count; i++) {
-        fprintf(
-            stderr,
-            "DEBUG - Comparing %s and %s during field access\n",
+        LOG_DEBUG(LOG_SEMA, "Comparing %s and %s during field access\n",
             cls->type_decl.fields[i]->field_def.name,
             node->field_access.field
          );
-        if (strcmp(cls->type_decl.fields[i]->field_def.name, node->field_access.field) == 0) {
-            fprintf(
-                stderr,
-                "INFO - Found position for %s -> %d\n",
+        if (cls->type_decl.fields[i]->field_def.name == node->field_access.field) {
+            LOG_INFO(LOG_SEMA, "Found position for %s -> %d\n",
                 cls->type_decl.fields[i]->field_def.name,
                 i + index
              );
@@ -343,9 +345,7 @@ int lookup_index(ASTNode* node, ASTNode* cls, SymbolTable* scope, ASTNode** corr
 int lookup_method_index(ASTNode* node, ASTNode* cls, SymbolTable* scope, SymbolTable* lookup_scope) {
     int index = 0;
     if (cls->type_decl.base_type) {
-        fprintf(
-            stderr,
-            "INFO - Found child class '%s' of '%s'\n",
+        LOG_INFO(LOG_SEMA, "Found child class '%s' of '%s'\n",
             cls->type_decl.name,
             cls->type_decl.base_type
         );
@@ -363,9 +363,7 @@ int lookup_method_index(ASTNode* node, ASTNode* cls, SymbolTable* scope, SymbolT
 
     int overriden = 0;
     for (int i = 0; i < (int) cls->type_decl.method_count; i++) {
-        fprintf(
-            stderr,
-            "DEBUG - Comparing %s and %s during method access\n",
+        LOG_DEBUG(LOG_SEMA, "Comparing %s and %s during method access\n",
             cls->type_decl.methods[i]->function_def.name,
             node->method_call.method
         );
@@ -375,10 +373,8 @@ int lookup_method_index(ASTNode* node, ASTNode* cls, SymbolTable* scope, SymbolT
             // this is definitely not the method we want
             continue;
         }
-        if (strcmp(cls->type_decl.methods[i]->function_def.name, node->method_call.method) == 0) {
-            fprintf(
-                stderr,
-                "INFO - Found position for method %s -> %d\n",
+        if (cls->type_decl.methods[i]->function_def.name == node->method_call.method) {
+            LOG_INFO(LOG_SEMA, "Found position for method %s -> %d\n",
                 cls->type_decl.methods[i]->function_def.name,
                 i + index - overriden
              );
@@ -396,23 +392,24 @@ void process_function_call(
     SymbolTable* current_scope
 ) {
     // 1. Lookup function definition
-    fprintf(stderr, "INFO - Looking for symbol %s\n", call->function_call.name);
+    LOG_INFO(LOG_SEMA, "Looking for symbol %s\n", call->function_call.name);
     ASTNode* function_def = symbol_table_lookup(current_scope, call->function_call.name);
 
     if(!function_def) {
-        fprintf(stderr,  "Undefined function '%s'\n", call->function_call.name);
-        if (phase > 0) {
+        if (cs->phase > 0) {
             // fail silently only during symbol lookup
+            LOG_ERROR(LOG_SEMA, "Undefined function '%s'\n", call->function_call.name);
             add_constraint(cs, create_ast_variable("Undefined function\n"), NULL);
-            exit(1);
+            compile_fail();
         }
+        LOG_DEBUG(LOG_SEMA, "Undefined function '%s'\n", call->function_call.name);
         return;
     }
 
     if(function_def->type != AST_FUNCTION_DEF) {
-        fprintf(stderr, "'%s' is not a function\n", call->function_call.name);
+        LOG_ERROR(LOG_SEMA, "'%s' is not a function\n", call->function_call.name);
         add_constraint(cs, create_ast_variable("Not a function\n"), NULL);
-        exit(1);
+        compile_fail();
         return;
     }
 
@@ -420,14 +417,14 @@ void process_function_call(
     function_def->function_def.called = 1;
 
     // 2. Create new scope for parameters
-    fprintf(stderr, "Creating new scope for function %s\n", call->function_call.name);
+    LOG_DEBUG(LOG_SEMA, "Creating new scope for function %s\n", call->function_call.name);
     SymbolTable* func_scope = create_symbol_table(current_scope);
 
     // 3. Process arguments and add to scope
     if(call->function_call.arg_count != function_def->function_def.arg_count) {
-        fprintf(stderr, "Argument count mismatch for '%s'\n",
+        LOG_ERROR(LOG_SEMA, "Argument count mismatch for '%s'\n",
                     call->function_call.name);
-        exit(1);
+        compile_fail();
         return;
     }
 
@@ -437,17 +434,15 @@ void process_function_call(
 
         // Add constraint: arg_type == param_type
         if (!function_def->function_def.args_definitions[i]) {
-            fprintf(
-                stderr,
-                "ERROR - No definition for %s in %s",
+            LOG_ERROR(LOG_SEMA, "No definition for %s in %s",
                 function_def->function_def.args[i],
                 function_def->function_def.name
             );
 
             add_constraint(cs, create_ast_variable("Definition not found\n"), NULL);
-            exit(1);
+            compile_fail();
         }
-        fprintf(stderr, "%p\n", function_def->function_def.args_definitions[i]);
+        LOG_DEBUG(LOG_SEMA, "%p\n", function_def->function_def.args_definitions[i]);
         add_constraint(
             cs,
             function_def->function_def.args_definitions[i],
@@ -455,9 +450,7 @@ void process_function_call(
         );
 
         // Add parameter to symbol table
-        fprintf(
-            stderr,
-            "INFO - Adding parameter '%s' to symbol table for function %s (type %zu)\n",
+        LOG_INFO(LOG_SEMA, "Adding parameter '%s' to symbol table for function %s (type %zu)\n",
             function_def->function_def.args[i],
             function_def->function_def.name,
             call->function_call.args[i]->type_info.kind
@@ -495,31 +488,25 @@ void process_method_call(
 
     ASTNode* ref = call->method_call.cls;
     if (!ref || !ref->type_info.cls) {
-        fprintf(
-            stderr,
-            "WARNING - Could not access the class via the instance in %d.%s\n",
+        LOG_WARNING(LOG_SEMA, "Could not access the class via the instance in %d.%s\n",
             ref->type,
             call->method_call.method
         );
         return;
     }
-    fprintf(stderr, "%p",ref->type_info.cls);
+    LOG_DEBUG(LOG_SEMA, "%p",ref->type_info.cls);
     ASTNode* cls = symbol_table_lookup(current_scope, ref->type_info.cls);
 
     if (cls->type_info.cls == NULL) {
         // no-op
-        fprintf(
-            stderr,
-            "ERROR - Class %s not found for method %s\n",
+        LOG_ERROR(LOG_SEMA, "Class %s not found for method %s\n",
             cls->type_decl.name,
             call->method_call.method
         );
 
         return;
     }
-    fprintf(
-        stderr,
-        "INFO - Accessing method '%s' of %s during analysis\n",
+    LOG_INFO(LOG_SEMA, "Accessing method '%s' of %s during analysis\n",
         call->method_call.method,
         cls->type_info.cls
     );
@@ -529,41 +516,39 @@ void process_method_call(
     function_def->function_def.called = 1;
 
     if(!function_def) {
-        fprintf(stderr,  "ERROR - Undefined method '%s'\n", call->method_call.method);
+        LOG_ERROR(LOG_SEMA, "Undefined method '%s'\n", call->method_call.method);
         add_constraint(cs, create_ast_variable("Function def not found\n"), NULL);
-        exit(1);
+        compile_fail();
         return;
     }
 
     if(function_def->type != AST_METHOD_DEF) {
-        fprintf(stderr, "ERORR - '%s' is not a method\n", call->method_call.method);
+        LOG_ERROR(LOG_SEMA, "'%s' is not a method\n", call->method_call.method);
         add_constraint(cs, create_ast_variable("Wrong method type\n"), NULL);
-        exit(1);
+        compile_fail();
         return;
     }
 
     // 2. Create new scope for parameters
-    fprintf(stderr, "Creating new scope for method %s\n", call->method_call.method);
+    LOG_DEBUG(LOG_SEMA, "Creating new scope for method %s\n", call->method_call.method);
     SymbolTable* func_scope = create_symbol_table(current_scope);
     //SymbolTable* func_scope = current_scope;
 
     // 3. Process arguments and add to scope
     if(call->method_call.arg_count != (function_def->function_def.arg_count)) {
-        fprintf(
-            stderr,
-            "ERROR - Argument count mismatch for '%s' (%d vs %d)\n",
+        LOG_ERROR(LOG_SEMA, "Argument count mismatch for '%s' (%d vs %d)\n",
             call->method_call.method,
             call->method_call.arg_count,
             function_def->function_def.arg_count
         );
         add_constraint(cs, create_ast_variable("Argument mismatch\n"), NULL);
-        exit(1);
+        compile_fail();
         return;
     }
 
     for(size_t i=0; i<call->method_call.arg_count; i++) {
         // Process argument expression
-        fprintf(stderr, "INFO - Method of type=%d (i=%zu)\n", call->method_call.args[i]->type, i);
+        LOG_INFO(LOG_SEMA, "Method of type=%d (i=%zu)\n", call->method_call.args[i]->type, i);
         _semantic_analysis(call->method_call.args[i], cs, func_scope);
 
         add_constraint(
@@ -573,9 +558,7 @@ void process_method_call(
         );
 
         // Add parameter to symbol table
-        fprintf(
-            stderr,
-            "INFO - Adding parameter '%s' to symbol table for method %s (type %zu)\n",
+        LOG_INFO(LOG_SEMA, "Adding parameter '%s' to symbol table for method %s (type %zu)\n",
             function_def->function_def.args[i],
             function_def->function_def.name,
             call->method_call.args[i]->type_info.kind
@@ -592,9 +575,7 @@ void process_method_call(
     if (function_def->type_info.kind == TYPE_UNKNOWN) {
         _semantic_analysis(function_def, cs, func_scope);
     }
-    fprintf(
-        stderr,
-        "-> %zu %s %zu %zu\n",
+    LOG_DEBUG(LOG_SEMA, "-> %zu %s %zu %zu\n",
         function_def->type_info.kind,
         function_def->function_def.name,
         function_def->function_def.args_definitions[0]->type_info.kind,
@@ -608,13 +589,11 @@ void process_let_in(
     ConstraintSystem* cs,
     SymbolTable* current_scope
 ) {
-    fprintf(stderr, "Creating new scope for let-in\n");
+    LOG_DEBUG(LOG_SEMA, "Creating new scope for let-in\n");
     SymbolTable* let_scope = create_symbol_table(current_scope);
 
     for(size_t i=0; i<node->let_in.var_count; i++) {
-        fprintf(
-            stderr,
-            "Adding parameter '%s' to symbol table for let-in (type %zu)\n",
+        LOG_DEBUG(LOG_SEMA, "Adding parameter '%s' to symbol table for let-in (type %zu)\n",
             node->let_in.var_names[i],
             node->let_in.var_values[i]->type_info.kind
         );
@@ -633,7 +612,7 @@ void process_let_in(
 void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scope) {
 
     if ((node->type_info.kind > 100) && (node->type_info.name == NULL)) {
-        fprintf(stderr, "--------- WARNING - %d %s %zu\n", node->type, node->variable.name, node->type_info.kind);
+        LOG_WARNING(LOG_SEMA, "%d %s %zu\n", node->type, node->variable.name, node->type_info.kind);
         //node->type_info.kind = 0;
         //exit(1);
     }
@@ -641,7 +620,7 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
         case AST_BINARY_OP: {
             // Both operands must be numeric
 
-            TypeInfo *lit = malloc(sizeof(TypeInfo));
+            TypeInfo *lit = hk_calloc(1, sizeof(TypeInfo));
             lit->kind = TYPE_DOUBLE;
             lit->is_literal = true;
 
@@ -653,7 +632,7 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
         }
 
         case AST_CONDITIONAL: {
-            TypeInfo *lit = malloc(sizeof(TypeInfo));
+            TypeInfo *lit = hk_calloc(1, sizeof(TypeInfo));
             lit->kind = TYPE_DOUBLE;
             lit->is_literal = true;
 
@@ -674,7 +653,7 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
         }
 
         case AST_BLOCK: {
-            fprintf(stderr, "INFO - Found block (size=%d) during constraint collection\n", node->block.stmt_count);
+            LOG_INFO(LOG_SEMA, "Found block (size=%d) during constraint collection\n", node->block.stmt_count);
 
             // depends on the type of the last statement
             if (node->block.stmt_count > 0) {
@@ -682,7 +661,7 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
                     &node->block.statements[node->block.stmt_count - 1]->type_info);
             }
             else {
-                TypeInfo *lit = malloc(sizeof(TypeInfo));
+                TypeInfo *lit = hk_calloc(1, sizeof(TypeInfo));
                 lit->kind = TYPE_DOUBLE;
                 lit->is_literal = true;
 
@@ -700,7 +679,7 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
             break;
         }
         case AST_FUNCTION_DEF: {
-            fprintf(stderr, "INFO - Found function (name=%s) during constraint collection\n", node->function_def.name);
+            LOG_INFO(LOG_SEMA, "Found function (name=%s) during constraint collection\n", node->function_def.name);
             symbol_table_add(current_scope, node->function_def.name, node);
 
             SymbolTable* func_scope = create_symbol_table(current_scope);
@@ -722,13 +701,14 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
             break;
         }
         case AST_VARIABLE: {
-            fprintf(stderr, "INFO - Found variable (name=%s) during constraint collection\n", node->variable.name);
+            LOG_INFO(LOG_SEMA, "Found variable (name=%s) during constraint collection\n", node->variable.name);
             ASTNode* variable_def = symbol_table_lookup(current_scope, node->variable.name);
 
             if (!variable_def) {
-                fprintf(stderr,  "Undefined variable '%s' [%d, %d]\n", node->variable.name, node->line, node->column);
+                SourcePosition position = source_position(node->offset);
+                LOG_ERROR(LOG_SEMA, "Undefined variable '%s' [%d, %d]\n", node->variable.name, position.line, position.column);
                 add_constraint(cs, create_ast_variable("Undefined variable\n"), NULL);
-                exit(1);
+                compile_fail();
                 break;
             }
 
@@ -752,7 +732,7 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
             break;
         }
         case AST_WHILE_LOOP: {
-            TypeInfo *lit = malloc(sizeof(TypeInfo));
+            TypeInfo *lit = hk_calloc(1, sizeof(TypeInfo));
             lit->kind = TYPE_DOUBLE;
             lit->is_literal = true;
 
@@ -764,10 +744,10 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
 
         case AST_NUMBER: {
             // Literals are terminal - no constraints
-            fprintf(stderr, "INFO - Found terminal %f during constraint collection\n", node->number);
+            LOG_INFO(LOG_SEMA, "Found terminal %f during constraint collection\n", node->number);
 
             // NOOB NOTE: If we don't malloc the memory is used by something else eventually
-            TypeInfo *lit = malloc(sizeof(TypeInfo));
+            TypeInfo *lit = hk_calloc(1, sizeof(TypeInfo));
             lit->kind = TYPE_DOUBLE;
             lit->is_literal = true;
 
@@ -777,10 +757,10 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
 
         case AST_STRING: {
             // Literals are terminal - no constraints
-            fprintf(stderr, "INFO - Found terminal '%s' during constraint collection\n", node->string);
+            LOG_INFO(LOG_SEMA, "Found terminal '%s' during constraint collection\n", node->string);
 
             // NOOB NOTE: If we don't malloc the memory is used by something else eventually
-            TypeInfo *lit = malloc(sizeof(TypeInfo));
+            TypeInfo *lit = hk_calloc(1, sizeof(TypeInfo));
             lit->kind = TYPE_STRING;
             lit->is_literal = true;
 
@@ -788,14 +768,14 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
             break;
         }
         case AST_CONSTRUCTOR: {
-            TypeInfo *lit = malloc(sizeof(TypeInfo));
+            TypeInfo *lit = hk_calloc(1, sizeof(TypeInfo));
             ASTNode* cls_def = symbol_table_lookup(current_scope, node->constructor.cls);
 
             lit->name = new_instance_type(node->constructor.cls);
-            lit->cls = strdup(node->constructor.cls);
-            lit->kind = hash(node->constructor.cls);
+            lit->cls = node->constructor.cls;
+            lit->kind = intern_hash(node->constructor.cls);
             lit->parent = cls_def->type_info.parent;
-            fprintf(stderr, "%p\n", cls_def->type_info.parent);
+            LOG_DEBUG(LOG_SEMA, "%p\n", cls_def->type_info.parent);
             lit->is_literal = true;
 
             add_constraint(cs, node, lit);
@@ -803,9 +783,10 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
 
 
             if (!cls_def) {
-                fprintf(stderr,  "Undefined class constructor '%s' [%d, %d]\n", node->constructor.cls, node->line, node->column);
+                SourcePosition position = source_position(node->offset);
+                LOG_ERROR(LOG_SEMA, "Undefined class constructor '%s' [%d, %d]\n", node->constructor.cls, position.line, position.column);
                 add_constraint(cs, create_ast_variable("Undefined class constructor\n"), NULL);
-                exit(1);
+                compile_fail();
                 break;
             }
             int index = node->constructor.arg_count - 1;
@@ -814,7 +795,7 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
                     if (i < 0) {
                         break;
                     }
-                    fprintf(stderr, "%d\n", i);
+                    LOG_DEBUG(LOG_SEMA, "%d\n", i);
                     add_constraint(
                         cs,
                         node->constructor.args[index],
@@ -822,18 +803,17 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
                     );
                     index -= 1;
                 }
-                fprintf(stderr, "%d %d\n", cls_def->type_decl.field_count, index);
-                fprintf(stderr, "%s\n", cls_def->type_decl.base_type);
+                LOG_DEBUG(LOG_SEMA, "%d %d\n", cls_def->type_decl.field_count, index);
+                LOG_DEBUG(LOG_SEMA, "%s\n", cls_def->type_decl.base_type);
                 if (index > 0 && (cls_def->type_decl.base_type == NULL)) {
-                    fprintf(
-                        stderr,
-                        "%d extra fields in constructor [%d, %d]\n",
+                    SourcePosition position = source_position(node->offset);
+                    LOG_ERROR(LOG_SEMA, "%d extra fields in constructor [%d, %d]\n",
                         index,
-                        node->line,
-                        node->column
+                        position.line,
+                        position.column
                     );
                     add_constraint(cs, create_ast_variable("Too many fields for constructor\n"), NULL);
-                    exit(1);
+                    compile_fail();
                 }
                 if (cls_def->type_decl.base_type != NULL) {
                     cls_def = symbol_table_lookup(current_scope, cls_def->type_decl.base_type);
@@ -862,7 +842,7 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
 
         case AST_TYPE_DEF: {
             symbol_table_add(current_scope, node->type_decl.name, node);
-            node->type_info.kind = hash(node->type_decl.name);
+            node->type_info.kind = intern_hash(node->type_decl.name);
             node->type_info.name = new_instance_type(node->type_decl.name);
             node->type_info.cls = node->type_decl.name;
 
@@ -897,18 +877,14 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
         case AST_FIELD_ACCESS: {
             ASTNode* ref = symbol_table_lookup(current_scope, node->field_access.cls);
             if (!ref || !ref->type_info.cls) {
-                fprintf(
-                    stderr,
-                    "-------------------- WARNING - Could not access the class via the instance in %s.%s\n",
+                LOG_WARNING(LOG_SEMA, "Could not access the class via the instance in %s.%s\n",
                     node->field_access.cls,
                     node->field_access.field
                 );
                 break;
             }
             ASTNode* cls = symbol_table_lookup(current_scope, ref->type_info.cls);
-            fprintf(
-                stderr,
-                "INFO - Accessing classs instance '%s' field '%s'\n",
+            LOG_INFO(LOG_SEMA, "Accessing classs instance '%s' field '%s'\n",
                 cls->type_info.cls,
                 node->field_access.field
             );
@@ -916,13 +892,12 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
             int res = lookup_index(node, cls, current_scope, &correct_field);
 
             if (correct_field == NULL) {
-                fprintf(
-                    stderr,
-                    "ERROR - Field not found (%s, %s) [%d, %d]\n",
+                SourcePosition position = source_position(node->offset);
+                LOG_ERROR(LOG_SEMA, "Field not found (%s, %s) [%d, %d]\n",
                     node->field_access.cls,
                     node->field_access.field,
-                    node->line,
-                    node->column
+                    position.line,
+                    position.column
                 );
                 // add error constraint
                 add_constraint(cs, create_ast_variable("Field not found\n"), NULL);
@@ -935,6 +910,7 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
         case AST_FIELD_REASSIGN: {
             ASTNode* val = symbol_table_lookup(current_scope, node->field_reassign.value);
             add_constraint(cs, node, &val->type_info);
+            break;
         }
         case AST_FIELD_DEF: {
             add_constraint(cs, node, &node->field_def.default_value->type_info);
@@ -945,7 +921,14 @@ void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scop
 
 // FLAT
 static void append_stmts(FlattenResult* dest, ASTNode** src, unsigned int count) {
-    dest->stmts = realloc(dest->stmts, (dest->stmt_count + count) * sizeof(ASTNode*));
+    if (dest->stmt_count + count > dest->stmt_capacity) {
+        unsigned int capacity = dest->stmt_capacity ? dest->stmt_capacity : 16;
+        while (capacity < dest->stmt_count + count) {
+            capacity *= 2;
+        }
+        dest->stmt_capacity = capacity;
+        dest->stmts = hk_realloc(dest->stmts, capacity * sizeof(ASTNode*));
+    }
     memcpy(dest->stmts + dest->stmt_count, src, count * sizeof(ASTNode*));
     dest->stmt_count += count;
 }
@@ -963,9 +946,7 @@ static FlattenResult flatten(ASTNode* node) {
             for (size_t i = 0; i < node->let_in.var_count; i++) {
                 FlattenResult val = flatten(node->let_in.var_values[i]);
                 if (val.stmts == NULL) {
-                    fprintf(
-                        stderr,
-                        "WARNING - NULL detected inside let-in (%s)",
+                    LOG_WARNING(LOG_SEMA, "NULL detected inside let-in (%s)",
                         node->let_in.var_names[i]
                     );
                 }
@@ -979,9 +960,7 @@ static FlattenResult flatten(ASTNode* node) {
                     val.expr
                 );
                 if (val.expr->type_info.kind == 0) {
-                    fprintf(
-                        stderr,
-                        "WARNING - Type=%zu (UNKOWN) for node type %d in let-in\n",
+                    LOG_WARNING(LOG_SEMA, "Type=%zu (UNKOWN) for node type %d in let-in\n",
                         node->let_in.var_values[i]->type_info.kind,
                         node->let_in.var_values[i]->type
                     );
@@ -990,17 +969,14 @@ static FlattenResult flatten(ASTNode* node) {
                 def->type_info.name = val.expr->type_info.name;
                 def->type_info.cls = val.expr->type_info.cls;
 
-                res.stmts = realloc(res.stmts, (res.stmt_count + 1) * sizeof(ASTNode*));
-                res.stmts[res.stmt_count++] = def;
+                append_stmts(&res, &def, 1);
             }
 
             // Process body
             FlattenResult body = flatten(node->let_in.body);
             
             if (body.stmts == NULL) {
-                fprintf(
-                    stderr,
-                    "WARNING - NULL detected inside let-in body"
+                LOG_WARNING(LOG_SEMA, "NULL detected inside let-in body"
                 );
             }
             else {
@@ -1029,26 +1005,21 @@ static ASTNode* transform_constructor(ASTNode* node) {
         node->constructor.arg_count
     );
     // XXX delet
-    new_node->type_info.cls = strdup(node->constructor.cls);
+    new_node->type_info.cls = node->constructor.cls;
     new_node->type_info.name = new_instance_type(node->constructor.cls);
-    new_node->type_info.kind = hash(cname);
+    new_node->type_info.kind = intern_hash(cname);
     new_node->type_info.is_literal = true;
 
-    // dealloc
-    free(node->constructor.cls);
-
     return new_node;
 }
 
 // Transform method calls
 static ASTNode* transform_method_call(ASTNode* node, SymbolTable* scope) {
     // self
-    fprintf(stderr, "INFO - Transforming method call\n");
+    LOG_INFO(LOG_SEMA, "Transforming method call\n");
     // XXX seems to rely on undefined behaviour
     // the lifetime of the string varies
-    fprintf(
-        stderr,
-        "INFO - Self type %zu %s\n",
+    LOG_INFO(LOG_SEMA, "Self type %zu %s\n",
         node->method_call.cls->type_info.kind,
         node->method_call.cls->type_info.cls
     );
@@ -1063,13 +1034,13 @@ static ASTNode* transform_method_call(ASTNode* node, SymbolTable* scope) {
 
 
 ASTNode* transform_ast(ASTNode* node, SymbolTable* scope) {
-    fprintf(stderr, "Node type=%d\n", node->type);
+    LOG_DEBUG(LOG_SEMA, "Node type=%d\n", node->type);
     if (!node) return NULL;
 
     // First transform children recursively
     switch (node->type) {
         case AST_BLOCK: {
-            fprintf(stderr, "Transforming AST_BLOCK\n");
+            LOG_DEBUG(LOG_SEMA, "Transforming AST_BLOCK\n");
             for (size_t i = 0; i < node->block.stmt_count; i++) {
                 node->block.statements[i] = transform_ast(node->block.statements[i], scope);
             }                      
@@ -1077,26 +1048,25 @@ ASTNode* transform_ast(ASTNode* node, SymbolTable* scope) {
         }
         case AST_METHOD_DEF:
         case AST_FUNCTION_DEF: {
-            fprintf(stderr, "Transforming AST_FUNCTION_DEF\n");
+            LOG_DEBUG(LOG_SEMA, "Transforming AST_FUNCTION_DEF\n");
             node->function_def.body = transform_ast(node->function_def.body, scope);
             break;
         }
         case AST_LET_IN: {
-            fprintf(stderr, "Transforming AST_LET_IN\n");
+            LOG_DEBUG(LOG_SEMA, "Transforming AST_LET_IN\n");
             FlattenResult washboard = flatten(node);
 
-            ASTNode* new_block = malloc(sizeof(ASTNode));
+            // the result of the evaluation of an expression block is the last expression evaluated
+            append_stmts(&washboard, &washboard.expr, 1);
+
+            ASTNode* new_block = hk_calloc(1, sizeof(ASTNode));
             new_block->type = AST_BLOCK;
             new_block->block.statements = washboard.stmts;
             new_block->block.stmt_count = washboard.stmt_count;
 
-            // the result of the evaluation of an expression block is the last expression evaluated
-            new_block->block.statements = realloc(new_block->block.statements, (new_block->block.stmt_count + 1) * sizeof(ASTNode*));
-            new_block->block.statements[new_block->block.stmt_count++] = washboard.expr;
-
             // free the *struct* holding the data
             // ... memory leak?
-            free(node);
+            hk_free(node);
 
             node = transform_ast(new_block, scope);
             break;
@@ -1118,10 +1088,10 @@ ASTNode* transform_ast(ASTNode* node, SymbolTable* scope) {
             node->binary_op.right = transform_ast(node->binary_op.right, scope);
 
             if (node->binary_op.op == OP_EXP) {
-                ASTNode** pow_args = malloc(sizeof(ASTNode*)*2);
+                ASTNode** pow_args = hk_malloc(sizeof(ASTNode*)*2);
                 pow_args[0] = node->binary_op.left;
                 pow_args[1] = node->binary_op.right;
-                node = create_ast_function_call("pow", pow_args, 2);
+                node = create_ast_function_call(intern("pow"), pow_args, 2);
                 node->type_info.kind = TYPE_DOUBLE;
             }
             break;
@@ -1141,7 +1111,7 @@ ASTNode* transform_ast(ASTNode* node, SymbolTable* scope) {
             break;
         }
         case AST_TYPE_DEF: {
-            fprintf(stderr, "INFO - Found type def %s\n", node->type_decl.name);
+            LOG_INFO(LOG_SEMA, "Found type def %s\n", node->type_decl.name);
             //coerce(node);
             for (size_t i = 0; i < node->type_decl.method_count; i++) {
                 node->type_decl.methods[i] = transform_ast(node->type_decl.methods[i], scope);
@@ -1153,9 +1123,7 @@ ASTNode* transform_ast(ASTNode* node, SymbolTable* scope) {
             //coerce(node);
 
             if (node->type_decl.base_type) {
-                fprintf(
-                    stderr,
-                    "INFO - Found child class '%s' of '%s'\n",
+                LOG_INFO(LOG_SEMA, "Found child class '%s' of '%s'\n",
                     node->type_decl.name,
                     node->type_decl.base_type
                 );
@@ -1163,9 +1131,10 @@ ASTNode* transform_ast(ASTNode* node, SymbolTable* scope) {
 
                 inherit(node, parent);
             }
-            char **cargs = malloc(sizeof(char*)*node->type_decl.field_count);
+            char **cargs = hk_malloc(sizeof(char*)*node->type_decl.field_count);
+            char* param = intern("[param]");
             for (unsigned int i = 0; i < node->type_decl.field_count; i++) {
-                cargs[i] = "[param]";
+                cargs[i] = param;
             }
             char *cname = new_constructor(node->type_decl.name);
             ASTNode* constructor = create_ast_function_def(
@@ -1176,7 +1145,7 @@ ASTNode* transform_ast(ASTNode* node, SymbolTable* scope) {
             );
 
             constructor->type_info.name = "CLASS_DEF";
-            constructor->type_info.kind = hash(cname);
+            constructor->type_info.kind = intern_hash(cname);
             constructor->type_info.cls = "CLASS_DEF";
 
             symbol_table_add(scope, cname, constructor);
@@ -1199,16 +1168,16 @@ ASTNode* transform_ast(ASTNode* node, SymbolTable* scope) {
 }
 
 static ASTNode* create_main_function(ASTNode** statements, unsigned int count) {
-    ASTNode* main_block = malloc(sizeof(ASTNode));
+    ASTNode* main_block = hk_calloc(1, sizeof(ASTNode));
     main_block->type = AST_BLOCK;
 
-    statements = realloc(statements, (count) * sizeof(ASTNode*));
+    statements = hk_realloc(statements, (count) * sizeof(ASTNode*));
     main_block->block.statements = statements;
     main_block->block.stmt_count = count;
 
-    ASTNode* main_func = malloc(sizeof(ASTNode));
+    ASTNode* main_func = hk_calloc(1, sizeof(ASTNode));
     main_func->type = AST_FUNCTION_DEF;
-    main_func->function_def.name = strdup("main");
+    main_func->function_def.name = intern("main");
     main_func->function_def.body = main_block;
     // explicit
     main_func->function_def.args = NULL;
@@ -1219,18 +1188,17 @@ static ASTNode* create_main_function(ASTNode** statements, unsigned int count) {
 }
 
 void sa_block(ASTNode *node) {
-    ASTNode **func_defs = NULL;
-    ASTNode **main_body = NULL;
+    // at most every statement goes to either side
+    ASTNode **func_defs = hk_malloc(node->block.stmt_count * sizeof(ASTNode*));
+    ASTNode **main_body = hk_malloc(node->block.stmt_count * sizeof(ASTNode*));
     unsigned int func_count = 0, main_count = 0;
 
     // Separate statements into function definitions and others
     for (unsigned int i = 0; i < node->block.stmt_count; i++) {
         ASTNode *stmt = node->block.statements[i];
         if ((stmt->type == AST_FUNCTION_DEF) || (stmt->type == AST_TYPE_DEF)) {
-            func_defs = realloc(func_defs, (func_count + 1) * sizeof(ASTNode*));
             func_defs[func_count++] = stmt;
         } else {
-            main_body = realloc(main_body, (main_count + 1) * sizeof(ASTNode*));
             main_body[main_count++] = stmt;
         }
     }
@@ -1238,7 +1206,7 @@ void sa_block(ASTNode *node) {
     // Create new statements array
     // always add a main function
     unsigned int new_count = func_count + 1;
-    ASTNode **new_statements = malloc(new_count * sizeof(ASTNode*));
+    ASTNode **new_statements = hk_malloc(new_count * sizeof(ASTNode*));
 
     // Copy function definitions
     if (func_count > 0) {
@@ -1250,15 +1218,15 @@ void sa_block(ASTNode *node) {
     new_statements[func_count] = main_func;
 
     // Replace original block contents
-    free(node->block.statements);
+    hk_free(node->block.statements);
     node->block.statements = new_statements;
     node->block.stmt_count = new_count;
 
     // Free temporary arrays (not the nodes!)
-    free(func_defs);
+    hk_free(func_defs);
     // we literally just give the pointer to the main
     // function so we can't free it
-    //free(main_body);
+    //hk_free(main_body);
 }
 
 void inherit(ASTNode* node, ASTNode* parent) {
@@ -1266,7 +1234,7 @@ void inherit(ASTNode* node, ASTNode* parent) {
 
     // 1. Handle field inheritance
     unsigned int total_fields = parent->type_decl.field_count + node->type_decl.field_count;
-    ASTNode** new_fields = malloc(total_fields * sizeof(ASTNode*));
+    ASTNode** new_fields = hk_malloc(total_fields * sizeof(ASTNode*));
 
     // Copy parent fields
     for (unsigned int i = 0; i < parent->type_decl.field_count; i++) {
@@ -1277,26 +1245,25 @@ void inherit(ASTNode* node, ASTNode* parent) {
     for (unsigned int i = 0; i < node->type_decl.field_count; i++) {
         // Check for field name conflicts
         for (unsigned int j = 0; j < parent->type_decl.field_count; j++) {
-            if (strcmp(node->type_decl.fields[i]->field_def.name,
-                      parent->type_decl.fields[j]->field_def.name) == 0) {
-                fprintf(stderr, "ERROR - Redeclaration of field '%s' in '%s'!\n",
+            if (node->type_decl.fields[i]->field_def.name == parent->type_decl.fields[j]->field_def.name) {
+                LOG_ERROR(LOG_SEMA, "Redeclaration of field '%s' in '%s'!\n",
                        node->type_decl.fields[i]->field_def.name,
                        node->type_decl.name);
-                free(new_fields);
-                exit(1);
+                hk_free(new_fields);
+                compile_fail();
             }
         }
         new_fields[parent->type_decl.field_count + i] = node->type_decl.fields[i];
     }
 
     // Replace old fields array
-    free(node->type_decl.fields);
+    hk_free(node->type_decl.fields);
     node->type_decl.fields = new_fields;
     node->type_decl.field_count = total_fields;
 
     // 2. Handle method inheritance
     unsigned int total_methods = parent->type_decl.method_count + node->type_decl.method_count;
-    ASTNode** new_methods = malloc(total_methods * sizeof(ASTNode*));
+    ASTNode** new_methods = hk_malloc(total_methods * sizeof(ASTNode*));
     unsigned int method_count = 0;
 
     // Copy parent methods (will be overridden if needed)
@@ -1310,8 +1277,7 @@ void inherit(ASTNode* node, ASTNode* parent) {
 
         // Check if this method overrides a parent method
         for (unsigned int j = 0; j < method_count; j++) {
-            if (strcmp(node->type_decl.methods[i]->function_def.name,
-                      new_methods[j]->function_def.name) == 0) {
+            if (node->type_decl.methods[i]->function_def.name == new_methods[j]->function_def.name) {
                 // Replace parent method with child override
                 new_methods[j] = node->type_decl.methods[i];
                 overridden = 1;
@@ -1326,22 +1292,22 @@ void inherit(ASTNode* node, ASTNode* parent) {
     }
 
     // Replace old methods array
-    free(node->type_decl.methods);
+    hk_free(node->type_decl.methods);
     node->type_decl.methods = new_methods;
     node->type_decl.method_count = method_count;
 
     // 3. Shrink array to actual size
     if (method_count < total_methods) {
-        ASTNode** shrunk_methods = realloc(new_methods, method_count * sizeof(ASTNode*));
+        ASTNode** shrunk_methods = hk_realloc(new_methods, method_count * sizeof(ASTNode*));
         if (shrunk_methods) {
             node->type_decl.methods = shrunk_methods;
         }
     }
 
     // Log final counts
-    fprintf(stderr, "INFO - Parent fields: %d; Child fields: %d\n",
+    LOG_INFO(LOG_SEMA, "Parent fields: %d; Child fields: %d\n",
            parent->type_decl.field_count, node->type_decl.field_count);
-    fprintf(stderr, "INFO - Parent methods: %d; Child methods: %d\n",
+    LOG_INFO(LOG_SEMA, "Parent methods: %d; Child methods: %d\n",
            parent->type_decl.method_count, node->type_decl.method_count);
 }
 
@@ -1354,7 +1320,7 @@ void _semantic_analysis(ASTNode *node, ConstraintSystem* cs, SymbolTable* scope)
 
     switch (node->type) {
         case AST_BLOCK: {
-            fprintf(stderr, "INFO - Performing sem_anal into code block\n");
+            LOG_INFO(LOG_SEMA, "Performing sem_anal into code block\n");
             // Recurse into new structure
             for (size_t i = 0; i < node->block.stmt_count; i++) {
                 _semantic_analysis(node->block.statements[i], cs, scope);
@@ -1362,7 +1328,7 @@ void _semantic_analysis(ASTNode *node, ConstraintSystem* cs, SymbolTable* scope)
             break;
         }
         case AST_FUNCTION_DEF: {
-            fprintf(stderr, "INFO - Performing sem_anal into function def %s\n", node->function_def.name);
+            LOG_INFO(LOG_SEMA, "Performing sem_anal into function def %s\n", node->function_def.name);
             break;
         }
         case AST_LET_IN: {
@@ -1373,7 +1339,7 @@ void _semantic_analysis(ASTNode *node, ConstraintSystem* cs, SymbolTable* scope)
             break;
         }
         case AST_FUNCTION_CALL: {
-            fprintf(stderr, "INFO - Performing sem_anal into function call %s\n", node->function_call.name);
+            LOG_INFO(LOG_SEMA, "Performing sem_anal into function call %s\n", node->function_call.name);
             // XXX args too
             //for (size_t i = 0; i < node->block.stmt_count; i++) {
             //    _semantic_analysis(node->function_call.args[i], cs, scope);
@@ -1381,72 +1347,68 @@ void _semantic_analysis(ASTNode *node, ConstraintSystem* cs, SymbolTable* scope)
             break;
         }
         case AST_VARIABLE_DEF: {
-            fprintf(stderr, "INFO - Performing sem_anal into variable def %s\n", node->variable_def.name);
+            LOG_INFO(LOG_SEMA, "Performing sem_anal into variable def %s\n", node->variable_def.name);
             _semantic_analysis(node->variable_def.body, cs, scope);
             break;
         }
         case AST_VARIABLE: {
-            fprintf(stderr, "INFO - Found terminal variable %s\n", node->variable.name);
+            LOG_INFO(LOG_SEMA, "Found terminal variable %s\n", node->variable.name);
             process_node(node, cs, scope);
             break;
         }
         case AST_NUMBER: {
-            fprintf(stderr, "INFO - Found terminal number %f\n", node->number);
+            LOG_INFO(LOG_SEMA, "Found terminal number %f\n", node->number);
             process_node(node, cs, scope);
             break;
         }
         case AST_STRING: {
-            fprintf(stderr, "INFO - Found terminal string %s\n", node->string);
+            LOG_INFO(LOG_SEMA, "Found terminal string %s\n", node->string);
             process_node(node, cs, scope);
             break;
         }
         case AST_BINARY_OP: {
-            fprintf(stderr, "INFO - Found binary op\n");
+            LOG_INFO(LOG_SEMA, "Found binary op\n");
             _semantic_analysis(node->binary_op.left, cs, scope);
             _semantic_analysis(node->binary_op.right, cs, scope);
             break;
         }
         case AST_CONDITIONAL: {
-            fprintf(stderr, "INFO - Found conditional\n");
+            LOG_INFO(LOG_SEMA, "Found conditional\n");
             _semantic_analysis(node->conditional.hypothesis, cs, scope);
             _semantic_analysis(node->conditional.thesis, cs, scope);
             _semantic_analysis(node->conditional.antithesis, cs, scope);
             break;
         }
         case AST_CONSTRUCTOR: {
-            fprintf(stderr, "INFO - Found constructor for %s\n", node->constructor.cls);
+            LOG_INFO(LOG_SEMA, "Found constructor for %s\n", node->constructor.cls);
             for (size_t i = 0; i < node->constructor.arg_count; i++) {
                 _semantic_analysis(node->constructor.args[i], cs, scope);
             }
             break;
         }
         case AST_TYPE_DEF: {
-            fprintf(stderr, "INFO - Found type def %s \n", node->type_decl.name);
+            LOG_INFO(LOG_SEMA, "Found type def %s \n", node->type_decl.name);
             for (size_t i = 0; i < node->type_decl.field_count; i++) {
                 _semantic_analysis(node->type_decl.fields[i], cs, scope);
                 _semantic_analysis(node->type_decl.fields[i]->field_def.default_value, cs, scope);
             }
             for (size_t i = 0; i < node->type_decl.method_count; i++) {
                 _semantic_analysis(node->type_decl.methods[i], cs, scope);
-                fprintf(stderr, "%d\n", node->type_decl.methods[i]->type);
+                LOG_DEBUG(LOG_SEMA, "%d\n", node->type_decl.methods[i]->type);
             }
             // no new global symbols inside methods nor class definitions
             // so we let the processor handle it
             break;
         }
         case AST_FIELD_DEF: {
-            fprintf(
-                stderr,
-                "INFO - Found field def %s\n",
+            LOG_INFO(LOG_SEMA, "Found field def %s\n",
                 node->field_def.name
             );
             _semantic_analysis(node->field_def.default_value, cs, scope);
             break;
         }
         case AST_FIELD_REASSIGN: {
-            fprintf(
-                stderr,
-                "INFO - Found field reassign %s.%s\n",
+            LOG_INFO(LOG_SEMA, "Found field reassign %s.%s\n",
                 node->field_reassign.field_access->field_access.cls,
                 node->field_reassign.field_access->field_access.field
             );
@@ -1454,9 +1416,7 @@ void _semantic_analysis(ASTNode *node, ConstraintSystem* cs, SymbolTable* scope)
         }
         case AST_FIELD_ACCESS: {
             // XXX
-            fprintf(
-                stderr,
-                "INFO - Found field access %s.%s\n",
+            LOG_INFO(LOG_SEMA, "Found field access %s.%s\n",
                 node->field_access.cls,
                 node->field_access.field
             );
@@ -1464,9 +1424,7 @@ void _semantic_analysis(ASTNode *node, ConstraintSystem* cs, SymbolTable* scope)
         }
 
         case AST_METHOD_CALL: {
-            fprintf(
-                stderr,
-                "INFO - Found method call %d.%s\n",
+            LOG_INFO(LOG_SEMA, "Found method call %d.%s\n",
                 node->method_call.cls->type,
                 node->method_call.method
             );
@@ -1485,43 +1443,52 @@ void _semantic_analysis(ASTNode *node, ConstraintSystem* cs, SymbolTable* scope)
     }
 }
 
-bool semantic_analysis(ASTNode *node) {
+bool semantic_analysis(ASTNode *node, SymbolTable* prelude) {
     switch (node->type) {
         // the only case
         case AST_BLOCK: {
             bool res;
-            SymbolTable* scope = create_symbol_table(NULL);
-            ConstraintSystem cs = {NULL, 0, 0};
+            // user code never writes to the prelude
+            SymbolTable* scope = create_symbol_table(prelude ? prelude : create_prelude());
+            ConstraintSystem cs = {NULL, 0, 0, 0};
 
             sa_block(node); // reorganize code in functions (transform the parent)
 
-            phase = 0;
+            cs.phase = 0;
+            timer_begin(PASS_SEMA_SYMBOLS);
             _semantic_analysis(node, &cs, scope); // symbol table
+            timer_end(PASS_SEMA_SYMBOLS);
             // dump old CS to reduce runtime
-            free(cs.constraints);
+            hk_free(cs.constraints);
 
             cs.constraints = NULL;
             cs.count = 0;
             cs.capacity = 0;
 
-            phase = 1;
+            cs.phase = 1;
+            timer_begin(PASS_SEMA_TYPES);
             _semantic_analysis(node, &cs, scope); // type checking (simple)
-            
+            timer_end(PASS_SEMA_TYPES);
+
             solve_constraints(&cs);
 
-            phase = 2;
+            cs.phase = 2;
+            timer_begin(PASS_SEMA_SYMBOL_TYPES);
             _semantic_analysis(node, &cs, scope); // type checking (symbols)
+            timer_end(PASS_SEMA_SYMBOL_TYPES);
 
             res = solve_constraints(&cs);
 
             // second round to get custom types
-            phase = 3;
+            cs.phase = 3;
+            timer_begin(PASS_TRANSFORM_AST);
             node = transform_ast(node, scope); // embrace FLATness (transform the children)
+            timer_end(PASS_TRANSFORM_AST);
 
             return res;
         }
         default: {
-            fprintf(stderr, "FATAL - Could not recognize root node (%d, it's not a block)\n", node->type);
+            LOG_ERROR(LOG_SEMA, "Could not recognize root node (%d, it's not a block)\n", node->type);
             return false;
         }
     }
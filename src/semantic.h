@@ -9,6 +9,7 @@
 typedef struct {
     ASTNode** stmts;
     unsigned int stmt_count;
+    unsigned int stmt_capacity;
     ASTNode* expr;
 } FlattenResult;
 
@@ -21,6 +22,7 @@ typedef struct {
     TypeConstraint* constraints;
     size_t count;
     size_t capacity;
+    int phase; // which pass of the analysis is running
 } ConstraintSystem;
 
 typedef struct SymbolEntry {
@@ -37,7 +39,12 @@ typedef struct SymbolTable {
 
 void inherit(ASTNode* node, ASTNode* parent);
 void _semantic_analysis(ASTNode *node, ConstraintSystem* cs, SymbolTable* scope);
-bool semantic_analysis(ASTNode *node);
+bool semantic_analysis(ASTNode *node, SymbolTable* prelude);
+
+// The builtins live in a scope of their own that can outlive a program;
+// reset it before reusing it for another one
+SymbolTable* create_prelude(void);
+void prelude_reset(SymbolTable* prelude);
 void symbol_table_add(SymbolTable* st, const char* name, ASTNode* node);
 void process_node(ASTNode* node, ConstraintSystem* cs, SymbolTable* current_scope);
 ASTNode* transform_ast(ASTNode* node, SymbolTable* scope);
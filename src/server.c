@@ -0,0 +1,298 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "server.h"
+#include "compiler.h"
+#include "semantic.h"
+
+#define CACHE_SIZE 64
+#define MAX_HEADER 4096
+// bigger SOURCE requests are refused before anything is allocated
+#define MAX_SOURCE ((size_t) 1 << 30)
+// clients are served one at a time, so one that stops sending or
+// reading is dropped after this many seconds instead of blocking the rest
+#define CLIENT_TIMEOUT 5
+
+typedef struct {
+    bool used;
+    // PATH requests are keyed by path, mtime and size
+    char* path;
+    struct timespec mtime;
+    off_t size;
+    // SOURCE requests by the whole buffer
+    uint64_t hash;
+    char* source;
+    size_t source_length;
+
+    bool ok;
+    char* ir;
+    size_t ir_size;
+    char* diagnostics;
+    size_t diagnostics_size;
+    unsigned long last_used;
+} CacheEntry;
+
+typedef struct {
+    SymbolTable* prelude;
+    CacheEntry cache[CACHE_SIZE];
+    unsigned long clock;
+} Server;
+
+static uint64_t hash_source(const char* source, size_t length) {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        h ^= (unsigned char) source[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static CacheEntry* cache_find_path(Server* server, const char* path, struct stat* st) {
+    for (int i = 0; i < CACHE_SIZE; i++) {
+        CacheEntry* e = &server->cache[i];
+        if (e->used && e->path && strcmp(e->path, path) == 0
+            && e->size == st->st_size
+            && e->mtime.tv_sec == st->st_mtim.tv_sec
+            && e->mtime.tv_nsec == st->st_mtim.tv_nsec) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static CacheEntry* cache_find_source(Server* server, const char* source, size_t length, uint64_t hash) {
+    for (int i = 0; i < CACHE_SIZE; i++) {
+        CacheEntry* e = &server->cache[i];
+        if (e->used && e->source && e->hash == hash && e->source_length == length
+            && memcmp(e->source, source, length) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static CacheEntry* cache_slot(Server* server, const char* path) {
+    // a newer result for the same file replaces the old one,
+    // otherwise take a free slot or the least recently used
+    CacheEntry* victim = &server->cache[0];
+    for (int i = 0; i < CACHE_SIZE; i++) {
+        CacheEntry* e = &server->cache[i];
+        if (!e->used || (path && e->path && strcmp(e->path, path) == 0)) {
+            victim = e;
+            break;
+        }
+        if (e->last_used < victim->last_used) {
+            victim = e;
+        }
+    }
+
+    free(victim->path);
+    free(victim->source);
+    free(victim->ir);
+    free(victim->diagnostics);
+    memset(victim, 0, sizeof(CacheEntry));
+    victim->used = true;
+    return victim;
+}
+
+static void compile_into(Server* server, CacheEntry* entry, const char* path, const char* source, size_t length) {
+    FILE* diagnostics = open_memstream(&entry->diagnostics, &entry->diagnostics_size);
+    FILE* output = open_memstream(&entry->ir, &entry->ir_size);
+
+    Compilation compilation;
+    compilation_init(&compilation, path, output, diagnostics);
+    compilation.prelude = server->prelude;
+    if (source != NULL) {
+        entry->ok = compile_source(&compilation, source, length);
+    }
+    else {
+        entry->ok = compile_file(&compilation);
+    }
+
+    fclose(output);
+    fclose(diagnostics);
+}
+
+static bool write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        length -= n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = read(fd, data, length);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        length -= n;
+    }
+    return true;
+}
+
+static bool read_header(int fd, char* header) {
+    for (int i = 0; i < MAX_HEADER - 1; i++) {
+        if (read(fd, &header[i], 1) != 1) {
+            return false;
+        }
+        if (header[i] == '\n') {
+            header[i] = '\0';
+            return true;
+        }
+    }
+    return false;
+}
+
+static void reply(int fd, bool ok, const char* ir, size_t ir_size, const char* diagnostics, size_t diagnostics_size) {
+    char header[64];
+    int length = snprintf(header, sizeof(header), "%s %zu %zu\n", ok ? "OK" : "ERR", ir_size, diagnostics_size);
+    if (write_all(fd, header, length) && write_all(fd, ir, ir_size)) {
+        write_all(fd, diagnostics, diagnostics_size);
+    }
+}
+
+static void reply_error(int fd, const char* message) {
+    reply(fd, false, "", 0, message, strlen(message));
+}
+
+static void handle(Server* server, int fd) {
+    char header[MAX_HEADER];
+    if (!read_header(fd, header)) {
+        return;
+    }
+
+    CacheEntry* entry = NULL;
+
+    if (strncmp(header, "PATH ", 5) == 0) {
+        const char* path = header + 5;
+        struct stat st;
+        bool found = (stat(path, &st) == 0);
+        if (found) {
+            entry = cache_find_path(server, path, &st);
+        }
+        if (entry == NULL) {
+            entry = cache_slot(server, path);
+            compile_into(server, entry, path, NULL, 0);
+            entry->path = strdup(path);
+            // a missing file never matches
+            entry->size = found ? st.st_size : -1;
+            entry->mtime = found ? st.st_mtim : (struct timespec) {0};
+        }
+    }
+    else if (strncmp(header, "SOURCE ", 7) == 0) {
+        const char* digits = header + 7;
+        char* end;
+        errno = 0;
+        unsigned long long length = strtoull(digits, &end, 10);
+        // strtoull takes signs and leading blanks, the protocol does not
+        if (*digits < '0' || *digits > '9' || *end != '\0' || errno == ERANGE) {
+            reply_error(fd, "Error: Invalid SOURCE length\n");
+            return;
+        }
+        if (length > MAX_SOURCE) {
+            reply_error(fd, "Error: Source too large\n");
+            return;
+        }
+        // the DFA stops at the terminator
+        char* source = malloc(length + 1);
+        if (source == NULL) {
+            reply_error(fd, "Error: Out of memory\n");
+            return;
+        }
+        if (!read_all(fd, source, length)) {
+            free(source);
+            return;
+        }
+        source[length] = '\0';
+
+        uint64_t hash = hash_source(source, length);
+        entry = cache_find_source(server, source, length, hash);
+        if (entry == NULL) {
+            entry = cache_slot(server, NULL);
+            compile_into(server, entry, "<source>", source, length);
+            entry->hash = hash;
+            entry->source = source;
+            entry->source_length = length;
+        }
+        else {
+            free(source);
+        }
+    }
+    else {
+        reply_error(fd, "Error: Expected PATH or SOURCE\n");
+        return;
+    }
+
+    entry->last_used = ++server->clock;
+    reply(fd, entry->ok, entry->ir, entry->ir_size, entry->diagnostics, entry->diagnostics_size);
+}
+
+int serve(const char* socket_path) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: Socket path '%s' is too long\n", socket_path);
+        return 1;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        fprintf(stderr, "Error: Could not create socket (%s)\n", strerror(errno));
+        return 1;
+    }
+    // a stale socket from a previous run; anything else is not ours to remove
+    struct stat st;
+    if (lstat(socket_path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "Error: '%s' exists and is not a socket\n", socket_path);
+            close(fd);
+            return 1;
+        }
+        unlink(socket_path);
+    }
+    if (bind(fd, (struct sockaddr*) &address, sizeof(address)) == -1 || listen(fd, 16) == -1) {
+        fprintf(stderr, "Error: Could not listen on '%s' (%s)\n", socket_path, strerror(errno));
+        close(fd);
+        return 1;
+    }
+
+    Server* server = calloc(1, sizeof(Server));
+    server->prelude = create_prelude();
+
+    while (true) {
+        int client = accept(fd, NULL, NULL);
+        if (client == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "Error: accept failed (%s)\n", strerror(errno));
+            break;
+        }
+        struct timeval timeout = {.tv_sec = CLIENT_TIMEOUT};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        handle(server, client);
+        close(client);
+    }
+
+    close(fd);
+    unlink(socket_path);
+    return 1;
+}
@@ -0,0 +1,26 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+/*
+ * Resident compiler listening on a Unix domain socket.
+ * One request per connection:
+ *
+ *   PATH <path>\n                  compile a file (as seen by the server)
+ *   SOURCE <length>\n<bytes>       compile a buffer (at most 1 GiB)
+ *
+ * and one reply:
+ *
+ *   OK <ir-length> <diagnostics-length>\n<ir><diagnostics>
+ *   ERR <ir-length> <diagnostics-length>\n<ir><diagnostics>
+ *
+ * Requests are served one at a time; a client that stalls for more
+ * than a few seconds is disconnected. The socket path must not exist
+ * or be a socket (left over from an earlier run).
+ *
+ * The builtins are set up once and recent results are kept, so asking
+ * again for an unchanged file (same mtime and size) or the same buffer
+ * costs nothing.
+ */
+int serve(const char* socket_path);
+
+#endif
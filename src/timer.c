@@ -0,0 +1,251 @@
+#include "timer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define MAX_DEPTH 64
+
+bool timer_enabled = false;
+static bool passes_enabled = false;
+static bool trace_enabled = false;
+static struct timespec origin;
+
+static const char* pass_names[PASS_COUNT] = {
+    [PASS_LEXER] = "lexer",
+    [PASS_PARSE] = "parse",
+    [PASS_SEMA_SYMBOLS] = "semantic analysis (symbols)",
+    [PASS_SEMA_TYPES] = "semantic analysis (types)",
+    [PASS_SEMA_SYMBOL_TYPES] = "semantic analysis (symbol types)",
+    [PASS_SOLVE_CONSTRAINTS] = "solve_constraints",
+    [PASS_TRANSFORM_AST] = "transform_ast",
+    [PASS_CODEGEN_DECLARATIONS] = "codegen_declarations",
+    [PASS_CODEGEN] = "codegen",
+};
+
+typedef struct {
+    double wall; // milliseconds
+    double cpu;
+    unsigned long calls;
+} PassTotal;
+
+typedef struct {
+    const char* name;
+    int pass; // -1 for plain spans
+    double start_wall;
+    double start_cpu;
+} OpenSpan;
+
+typedef struct {
+    char* name;
+    double start; // microseconds since timer_enable
+    double duration;
+    int tid;
+} TraceEvent;
+
+typedef struct {
+    TraceEvent* events;
+    size_t count;
+    size_t capacity;
+} TraceLog;
+
+static _Thread_local struct {
+    OpenSpan stack[MAX_DEPTH];
+    int depth;
+    int open[PASS_COUNT];
+    PassTotal totals[PASS_COUNT];
+    TraceLog trace;
+    int tid;
+} local;
+
+// everything handed over by timer_flush
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static PassTotal totals[PASS_COUNT];
+static TraceLog trace;
+static int thread_count = 0;
+
+static double elapsed_ms(clockid_t clock, const struct timespec* since) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    double ms = (now.tv_sec * 1e3) + (now.tv_nsec / 1e6);
+    if (since) {
+        ms -= (since->tv_sec * 1e3) + (since->tv_nsec / 1e6);
+    }
+    return ms;
+}
+
+static void trace_append(TraceLog* log, TraceEvent event) {
+    if (log->count == log->capacity) {
+        log->capacity = log->capacity ? log->capacity * 2 : 256;
+        log->events = realloc(log->events, sizeof(TraceEvent) * log->capacity);
+    }
+    log->events[log->count++] = event;
+}
+
+void timer_enable(bool time_passes, bool tracing) {
+    passes_enabled = time_passes;
+    trace_enabled = tracing;
+    timer_enabled = time_passes || tracing;
+    clock_gettime(CLOCK_MONOTONIC, &origin);
+}
+
+static void push(const char* name, int pass) {
+    if (local.depth < MAX_DEPTH) {
+        local.stack[local.depth] = (OpenSpan) {
+            name,
+            pass,
+            elapsed_ms(CLOCK_MONOTONIC, &origin),
+            elapsed_ms(CLOCK_THREAD_CPUTIME_ID, NULL),
+        };
+    }
+    local.depth += 1;
+}
+
+static void pop(bool traced) {
+    local.depth -= 1;
+    if (local.depth < 0) {
+        // unbalanced end after a flush
+        local.depth = 0;
+        return;
+    }
+    if (local.depth >= MAX_DEPTH) {
+        return;
+    }
+
+    OpenSpan* span = &local.stack[local.depth];
+    double wall = elapsed_ms(CLOCK_MONOTONIC, &origin) - span->start_wall;
+    double cpu = elapsed_ms(CLOCK_THREAD_CPUTIME_ID, NULL) - span->start_cpu;
+
+    if (span->pass >= 0 && local.open[span->pass] == 0) {
+        local.totals[span->pass].wall += wall;
+        local.totals[span->pass].cpu += cpu;
+        local.totals[span->pass].calls += 1;
+    }
+
+    if (trace_enabled && traced) {
+        if (local.tid == 0) {
+            local.tid = __atomic_add_fetch(&thread_count, 1, __ATOMIC_RELAXED);
+        }
+        trace_append(&local.trace, (TraceEvent) {
+            strdup(span->name),
+            span->start_wall * 1e3,
+            wall * 1e3,
+            local.tid,
+        });
+    }
+}
+
+void timer_begin(Pass pass) {
+    if (!timer_enabled) {
+        return;
+    }
+    push(pass_names[pass], pass);
+    local.open[pass] += 1;
+}
+
+void timer_end(Pass pass) {
+    if (!timer_enabled) {
+        return;
+    }
+    local.open[pass] -= 1;
+    // one event per token would drown the trace; the lexer only shows in the table
+    pop(pass != PASS_LEXER);
+}
+
+void timer_begin_span(const char* name) {
+    if (!trace_enabled) {
+        return;
+    }
+    push(name, -1);
+}
+
+void timer_end_span(void) {
+    if (!trace_enabled) {
+        return;
+    }
+    pop(true);
+}
+
+void timer_flush(void) {
+    if (!timer_enabled) {
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < PASS_COUNT; i++) {
+        totals[i].wall += local.totals[i].wall;
+        totals[i].cpu += local.totals[i].cpu;
+        totals[i].calls += local.totals[i].calls;
+    }
+    for (size_t i = 0; i < local.trace.count; i++) {
+        trace_append(&trace, local.trace.events[i]);
+    }
+    pthread_mutex_unlock(&lock);
+
+    // spans left open by compile_fail() are dropped
+    free(local.trace.events);
+    int tid = local.tid;
+    memset(&local, 0, sizeof(local));
+    local.tid = tid;
+}
+
+void timer_report(FILE* output) {
+    if (!passes_enabled) {
+        return;
+    }
+    fprintf(output, "===------------------------------------------------------------===\n");
+    fprintf(output, "                         Pass timings\n");
+    fprintf(output, "===------------------------------------------------------------===\n");
+    fprintf(output, "  %10s  %10s  %8s  %s\n", "Wall (ms)", "CPU (ms)", "Calls", "Pass");
+    for (int i = 0; i < PASS_COUNT; i++) {
+        fprintf(output, "  %10.3f  %10.3f  %8lu  %s\n", totals[i].wall, totals[i].cpu, totals[i].calls, pass_names[i]);
+    }
+    fprintf(output, "(the lexer runs inside parse and solve_constraints inside the other passes)\n");
+}
+
+static void write_json_string(FILE* file, const char* s) {
+    fputc('"', file);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', file);
+            fputc(*s, file);
+        }
+        else if ((unsigned char) *s < 0x20) {
+            fprintf(file, "\\u%04x", *s);
+        }
+        else {
+            fputc(*s, file);
+        }
+    }
+    fputc('"', file);
+}
+
+bool timer_write_trace(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        return false;
+    }
+
+    // chrome://tracing "complete" events
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (size_t i = 0; i < trace.count; i++) {
+        TraceEvent* event = &trace.events[i];
+        fprintf(file, "  {\"name\":");
+        write_json_string(file, event->name);
+        fprintf(
+            file,
+            ",\"cat\":\"helk\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}%s\n",
+            event->start,
+            event->duration,
+            event->tid,
+            (i + 1 < trace.count) ? "," : ""
+        );
+        free(event->name);
+    }
+    fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+
+    free(trace.events);
+    trace.events = NULL;
+    trace.count = trace.capacity = 0;
+    return fclose(file) == 0;
+}
@@ -0,0 +1,39 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+typedef enum {
+    PASS_LEXER,
+    PASS_PARSE,
+    PASS_SEMA_SYMBOLS,      // _semantic_analysis phase 0
+    PASS_SEMA_TYPES,        // phase 1
+    PASS_SEMA_SYMBOL_TYPES, // phase 2
+    PASS_SOLVE_CONSTRAINTS,
+    PASS_TRANSFORM_AST,
+    PASS_CODEGEN_DECLARATIONS,
+    PASS_CODEGEN,
+    PASS_COUNT
+} Pass;
+
+// set once before compiling; when both are off a span costs one branch
+extern bool timer_enabled;
+
+void timer_enable(bool time_passes, bool tracing);
+
+// spans nest; a pass that is already open on this thread is only
+// counted once in the table (solve_constraints recurses)
+void timer_begin(Pass pass);
+void timer_end(Pass pass);
+// trace-only spans (one per function definition and so on)
+void timer_begin_span(const char* name);
+void timer_end_span(void);
+
+// hand this thread's numbers over at the end of a compilation
+void timer_flush(void);
+
+void timer_report(FILE* output);
+bool timer_write_trace(const char* path);
+
+#endif
@@ -1,7 +1,11 @@
+import json
 import re
 import unittest
 import os
+import socket
 import subprocess
+import tempfile
+import time
 from pathlib import Path
 
 
@@ -62,6 +66,236 @@ class TestCompiler(unittest.TestCase):
             Path(self.LLVM_IR_FILE).unlink(missing_ok=True)
             Path(self.OUTPUT_FILE).unlink(missing_ok=True)
 
+    def compile_text(self, source, *options, threads=None):
+        """Compile source (bytes) from a file, return the finished process."""
+        path = Path(".temp.hk")
+        path.write_bytes(source)
+        env = dict(os.environ)
+        if threads is not None:
+            env["HELK_PARSE_THREADS"] = str(threads)
+        try:
+            return subprocess.run(
+                [self.COMPILER, *options, str(path)],
+                capture_output=True,
+                text=True,
+                env=env,
+            )
+        finally:
+            path.unlink(missing_ok=True)
+
+    def test_line_breaks(self):
+        # '\r' starts a line like '\n' does, so "\r\n" counts twice
+        result = self.compile_text(b"print(1);\r\nprint(2) print(3);\r\n")
+        self.assertNotEqual(result.returncode, 0)
+        self.assertIn("Unexpected token (print) [3, 10]", result.stderr)
+
+        result = self.compile_text(b"print(1);\rprint(2) print(3);\r")
+        self.assertIn("Unexpected token (print) [2, 10]", result.stderr)
+
+    def compile_traced(self, source, *options, threads=None):
+        """Like compile_text, also return the parse parts in the trace."""
+        with tempfile.TemporaryDirectory() as tracedir:
+            trace = os.path.join(tracedir, "trace.json")
+            result = self.compile_text(source, f"--trace={trace}", *options, threads=threads)
+            with open(trace) as file:
+                events = json.load(file)["traceEvents"]
+        return result, sum(event["name"] == "parse part" for event in events)
+
+    @staticmethod
+    def split_units(count):
+        """
+        Statements for a program big enough that frontend.c cuts it in
+        parts (64K at least each). Read as code, the literals would close
+        the call and have ';' outside of any parentheses: the cuts have
+        to skip them, escaped quotes included. The if blocks have ';' one
+        brace deep.
+        """
+        text = ') ; ( } ; { \\" ; ' * 100
+        return [
+            f'prints("{text}");\n'
+            f"let x{i} = if ({i % 2}) {{\n"
+            f"    let t = (({i} + 1) * 2);\n"
+            f"    t - {i % 7};\n"
+            f"}} else {{\n"
+            f"    ({i} * (3 + 1));\n"
+            f"}};\n"
+            f"print(x{i});\n"
+            for i in range(count)
+        ]
+
+    def test_parallel_parse(self):
+        source = "".join(self.split_units(200)).encode()
+        threaded, parts = self.compile_traced(source, "-v", threads=4)
+        serial = self.compile_text(source, threads=1)
+
+        self.assertEqual(serial.returncode, 0, serial.stderr)
+        self.assertEqual(parts, 4)
+        self.assertNotIn("Parsing again", threaded.stderr)
+        self.assertEqual(threaded.stdout, serial.stdout)
+
+    def test_parallel_parse_errors(self):
+        # in the middle part: a syntax error, and an action that gives up
+        # on the compilation; either way the diagnostics are the serial ones
+        for broken in ("print(x1 x1);\n", "let a = 1, b = 2;\n"):
+            units = self.split_units(200)
+            units.insert(len(units) // 2, broken)
+            source = "".join(units).encode()
+            threaded, parts = self.compile_traced(source, "-v", threads=4)
+            serial = self.compile_text(source, "-v", threads=1)
+
+            self.assertNotEqual(threaded.returncode, 0)
+            self.assertEqual(parts, 4)
+            # the INFO line is compiled out of release builds
+            again = "INFO - Parsing again on one thread for the diagnostics\n"
+            self.assertEqual(threaded.stderr.replace(again, ""), serial.stderr)
+
+    def test_batch(self):
+        names = ["arithmetic", "builtins", "fib"]
+        paths = [os.path.join(self.TEST_DIR, f"{name}.hk") for name in names]
+        with tempfile.TemporaryDirectory() as outdir:
+            result = subprocess.run(
+                [self.COMPILER, "--batch", *paths, "-o", outdir],
+                capture_output=True,
+                text=True,
+            )
+            self.assertEqual(result.returncode, 0, result.stderr)
+
+            for name, path in zip(names, paths):
+                single = subprocess.run(
+                    [self.COMPILER, path], check=True, capture_output=True, text=True
+                )
+                batched = Path(outdir, f"{name}.ll").read_text()
+                self.assertEqual(batched.strip(), single.stdout.strip())
+
+    def test_batch_same_output(self):
+        path = os.path.join(self.TEST_DIR, "arithmetic.hk")
+        with tempfile.TemporaryDirectory() as outdir:
+            other = Path(outdir, "arithmetic.hk")
+            other.write_text(Path(path).read_text())
+            result = subprocess.run(
+                [self.COMPILER, "--batch", path, str(other), "-o", outdir],
+                capture_output=True,
+                text=True,
+            )
+            self.assertEqual(result.returncode, 1)
+            self.assertIn("both compile to", result.stderr)
+            self.assertFalse(Path(outdir, "arithmetic.ll").exists())
+
+    @staticmethod
+    def ask_server(socket_path, request):
+        """Send one request, return (status, ir, diagnostics)."""
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as client:
+            client.connect(socket_path)
+            client.sendall(request)
+            reply = b""
+            while chunk := client.recv(65536):
+                reply += chunk
+        header, _, body = reply.partition(b"\n")
+        status, ir_size, _ = header.split()
+        ir_size = int(ir_size)
+        return status.decode(), body[:ir_size].decode(), body[ir_size:].decode()
+
+    def test_server(self):
+        path = os.path.join(self.TEST_DIR, "arithmetic.hk")
+        single = subprocess.run(
+            [self.COMPILER, path], check=True, capture_output=True, text=True
+        )
+        with tempfile.TemporaryDirectory() as directory:
+            socket_path = os.path.join(directory, "helk.sock")
+            server = subprocess.Popen(
+                [self.COMPILER, "--serve", socket_path],
+                stdout=subprocess.DEVNULL,
+                stderr=subprocess.DEVNULL,
+            )
+            try:
+                for _ in range(100):
+                    if os.path.exists(socket_path):
+                        break
+                    time.sleep(0.05)
+
+                absolute = os.path.abspath(path).encode()
+                status, ir, _ = self.ask_server(socket_path, b"PATH " + absolute + b"\n")
+                self.assertEqual(status, "OK")
+                self.assertEqual(ir.strip(), single.stdout.strip())
+
+                source = Path(path).read_bytes()
+                request = f"SOURCE {len(source)}\n".encode() + source
+                status, ir, _ = self.ask_server(socket_path, request)
+                self.assertEqual(status, "OK")
+                self.assertEqual(ir.strip(), single.stdout.strip())
+
+                source = b"print(1) print(2);"
+                request = f"SOURCE {len(source)}\n".encode() + source
+                status, _, diagnostics = self.ask_server(socket_path, request)
+                self.assertEqual(status, "ERR")
+                self.assertIn("Unexpected token (print)", diagnostics)
+            finally:
+                server.terminate()
+                server.wait()
+
+    def test_server_refuses_other_files(self):
+        with tempfile.TemporaryDirectory() as directory:
+            path = Path(directory, "notes.txt")
+            path.write_text("keep me\n")
+            result = subprocess.run(
+                [self.COMPILER, "--serve", str(path)],
+                capture_output=True,
+                text=True,
+                timeout=10,
+            )
+            self.assertEqual(result.returncode, 1)
+            self.assertEqual(path.read_text(), "keep me\n")
+
+    def skip_without_llvm(self, result):
+        if "needs a compiler built with LLVM" in result.stderr:
+            self.skipTest("compiler built without LLVM")
+
+    def test_run(self):
+        path = os.path.join(self.TEST_DIR, "arithmetic.hk")
+        result = subprocess.run(
+            [self.COMPILER, "--run", path], capture_output=True, text=True
+        )
+        self.skip_without_llvm(result)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        expected = Path(self.TEST_DIR, "arithmetic.out").read_text()
+        self.assertEqual(result.stdout.strip(), expected.strip())
+
+        result = self.compile_text(b"print(1) print(2);", "--run")
+        self.assertEqual(result.returncode, 1)
+        self.assertIn("Unexpected token (print)", result.stderr)
+
+    def test_emit(self):
+        path = os.path.join(self.TEST_DIR, "arithmetic.hk")
+        expected = Path(self.TEST_DIR, "arithmetic.out").read_text().strip()
+        with tempfile.TemporaryDirectory() as directory:
+            output = os.path.join(directory, "arithmetic")
+
+            result = subprocess.run(
+                [self.COMPILER, "--emit=bc", path, "-o", output + ".bc"],
+                capture_output=True,
+                text=True,
+            )
+            self.skip_without_llvm(result)
+            self.assertEqual(result.returncode, 0, result.stderr)
+            self.assertEqual(Path(output + ".bc").read_bytes()[:4], b"BC\xc0\xde")
+
+            subprocess.run(
+                [self.COMPILER, "--emit=obj", path, "-o", output + ".o"], check=True
+            )
+            subprocess.run(
+                ["clang", "-lm", output + ".o", self.BUILTINS_FILE, "-o", output],
+                check=True,
+            )
+            result = subprocess.run([output], capture_output=True, text=True)
+            self.assertEqual(result.stdout.strip(), expected)
+            os.unlink(output)
+
+            subprocess.run(
+                [self.COMPILER, "--emit=exe", path, "-o", output], check=True
+            )
+            result = subprocess.run([output], capture_output=True, text=True)
+            self.assertEqual(result.stdout.strip(), expected)
+
     @classmethod
     def create_test_methods(cls):
         test_dir = Path(cls.TEST_DIR)